@@ -0,0 +1,205 @@
+/**
+ * Copyright (c) 2013, Lorenz Moesenlechner <moesenle@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The names of the contributors may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/atomic.hpp>
+#include <boost/bind/bind.hpp>
+#include <boost/function.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/optional.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <generic_message/compiled_message.h>
+#include <generic_message/message_view.h>
+
+namespace generic_message {
+
+class BatchFailed : public std::runtime_error {
+ public:
+  BatchFailed(size_t index, const std::string &message)
+      : std::runtime_error(message), index_(index) {}
+
+  // Index of the buffer whose callback failed.
+  size_t index() const { return index_; }
+
+ private:
+  size_t index_;
+};
+
+class InvalidExtraction : public std::runtime_error {
+ public:
+  InvalidExtraction(const std::string &message)
+      : std::runtime_error(message) {}
+};
+
+// Memory owned by one worker of a BatchExecutor and reused for every
+// message it processes, so that callbacks do not need to allocate.
+class BatchScratch : private boost::noncopyable {
+ public:
+  static const size_t kBlockSize = 64 * 1024;
+
+  BatchScratch(size_t worker);
+
+  // Index of the worker, below BatchExecutor::threadCount(). Useful to
+  // index per-thread state kept by the caller.
+  size_t worker() const { return worker_; }
+  // View of the current message. Its offset table is reused.
+  const MessageView &view() const { return *view_; }
+  // Returns size bytes aligned to 16 that stay valid until the callback
+  // returns. The memory is recycled for the next message.
+  void *allocate(size_t size);
+  // A buffer that is kept between messages, e.g. for converted copies.
+  std::vector<uint8_t> &buffer() { return buffer_; }
+
+ private:
+  friend class BatchExecutor;
+
+  size_t worker_;
+  boost::optional<MessageView> view_;
+  std::vector<std::vector<uint8_t> > blocks_;
+  // Current block and the number of bytes used in it.
+  size_t block_;
+  size_t used_;
+  std::vector<uint8_t> buffer_;
+
+  void reset(const CompiledMessage &message, const void *data);
+};
+
+// Processes batches of messages of one type on a pool of threads. Each
+// worker starts with an equal share of the batch and takes small chunks
+// from the front of it; workers that run out steal half of the remaining
+// share of another worker, so batches of unevenly sized messages stay
+// balanced. The calling thread takes part as worker 0.
+//
+// Callbacks for different buffers run concurrently and in no particular
+// order. transform() and extract() store their results by buffer index,
+// so their outputs are in input order. If a callback throws, remaining
+// buffers are skipped and the call throws BatchFailed.
+class BatchExecutor : private boost::noncopyable {
+ public:
+  typedef boost::function<void (
+      size_t index, const MessageView &view, BatchScratch *scratch)>
+      callback_type;
+
+  // Uses one thread per core if threads is 0.
+  explicit BatchExecutor(size_t threads = 0);
+  ~BatchExecutor();
+
+  size_t threadCount() const { return workers_.size(); }
+
+  void forEach(
+      const CompiledMessage &message, const std::vector<const void *> &buffers,
+      const callback_type &callback);
+  void forEach(
+      const CompiledMessage &message,
+      const std::vector<std::vector<uint8_t> > &buffers,
+      const callback_type &callback);
+
+  // Stores the result of function, called with the view and scratch of
+  // each message, for buffers[i] in (*results)[i]. T must
+  // not be bool since elements of std::vector<bool> can not be written
+  // concurrently.
+  template<typename T, typename Buffers, typename Function>
+  void transform(
+      const CompiledMessage &message, const Buffers &buffers,
+      const Function &function, std::vector<T> *results) {
+    boost::function<T (const MessageView &, BatchScratch *)> wrapped(function);
+    results->resize(buffers.size());
+    forEach(message, buffers, boost::bind(
+        &BatchExecutor::storeResult<T>, &wrapped, results,
+        boost::placeholders::_1, boost::placeholders::_2,
+        boost::placeholders::_3));
+  }
+
+  // Reads the numeric fields addressed by paths from every buffer and
+  // stores them in row major order, i.e. the value of paths[j] in
+  // buffers[i] ends up in (*values)[i * paths.size() + j]. time and
+  // duration are converted to seconds. Throws InvalidExtraction if a path
+  // does not address a numeric field.
+  void extract(
+      const CompiledMessage &message, const std::vector<const void *> &buffers,
+      const std::vector<std::string> &paths, std::vector<double> *values);
+  void extract(
+      const CompiledMessage &message,
+      const std::vector<std::vector<uint8_t> > &buffers,
+      const std::vector<std::string> &paths, std::vector<double> *values);
+
+ private:
+  struct Worker;
+
+  std::vector<Worker *> workers_;
+  std::vector<boost::thread *> threads_;
+
+  // Serializes batches submitted from different threads.
+  boost::mutex batch_mutex_;
+
+  boost::mutex mutex_;
+  boost::condition_variable start_;
+  boost::condition_variable done_;
+  // Incremented for every batch to wake up the threads.
+  size_t generation_;
+  // Number of threads still working on the current batch.
+  size_t running_;
+  bool stopping_;
+
+  // The current batch.
+  const CompiledMessage *message_;
+  const std::vector<const void *> *buffers_;
+  const callback_type *callback_;
+  boost::atomic<bool> failed_;
+  size_t failed_index_;
+  std::string failure_;
+
+  template<typename T>
+  static void storeResult(
+      const boost::function<T (const MessageView &, BatchScratch *)> *function,
+      std::vector<T> *results, size_t index, const MessageView &view,
+      BatchScratch *scratch) {
+    (*results)[index] = (*function)(view, scratch);
+  }
+
+  void threadMain(size_t worker);
+  void work(size_t worker);
+  // Records the first failure of a batch.
+  void fail(size_t index, const std::string &failure);
+  bool take(size_t worker, size_t *begin, size_t *end);
+  bool steal(size_t worker);
+};
+
+}  // namespace generic_message
@@ -29,16 +29,20 @@
 
 #pragma once
 
-#include <map>
+#include <stdint.h>
+
 #include <stdexcept>
 #include <string>
+#include <vector>
 
-#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
 
 #include <generic_message/parsed_message.h>
+#include <generic_message/string_table.h>
 
 namespace generic_message {
 
+class FieldPath;
 class MessagePool;
 
 class CompilationFailed : public std::runtime_error {
@@ -47,49 +51,164 @@ class CompilationFailed : public std::runtime_error {
       : std::runtime_error(message) {}
 };
 
+class FieldNotFound : public std::runtime_error {
+ public:
+  FieldNotFound(const std::string &message)
+      : std::runtime_error(message) {}
+};
+
+class InvalidMessage : public std::runtime_error {
+ public:
+  InvalidMessage(const std::string &message)
+      : std::runtime_error(message) {}
+};
+
+// A message definition compiled for fast access to serialized messages.
+// Names and sub-messages are referenced by integer ids, so the fields of
+// a message are stored in a single contiguous array. Offsets of fields
+// that follow dynamically sized fields are computed by summing the sizes
+// of the dynamic fields in front of them.
 class CompiledMessage {
  public:
-  class AccessPath {
-   public:
-    AccessPath();
-    AccessPath(size_t offset, boost::function<size_t (const void *)> dynamic_offset);
-    size_t offset(const void *data) const {
-      return offset_ + dynamic_offset_(data);
+  struct CompiledField {
+    typedef enum {
+      BASE, MESSAGE, BASE_ARRAY, MESSAGE_ARRAY
+    } field_kind;
+
+    // How the size of the field is computed.
+    typedef enum {
+      // The field always has size bytes.
+      FIXED_SIZE,
+      // A length prefixed string.
+      STRING_SIZE,
+      // A length prefixed array of fixed size elements.
+      ELEMENTS_SIZE,
+      // An array of strings.
+      STRINGS_SIZE,
+      // A message with dynamic fields.
+      MESSAGE_SIZE,
+      // An array of messages with dynamic fields.
+      MESSAGES_SIZE
+    } sizing_kind;
+
+    static const uint32_t kUnbounded = 0xffffffff;
+
+    // Id of the field name in the pool's string table.
+    uint32_t name;
+    uint8_t kind;
+    uint8_t sizing;
+    // BaseType::base_type of base types and their arrays.
+    uint8_t base_type;
+    uint8_t reserved;
+    // Index of the sub-message of message fields and arrays, see
+    // CompiledMessage::subMessage.
+    uint32_t message;
+    // Number of elements of arrays, kUnbounded if the array has a length
+    // prefix.
+    uint32_t array_length;
+    // Size of the elements of arrays with fixed size elements.
+    uint32_t element_size;
+    // Size of fixed size fields, zero for dynamic fields.
+    uint32_t size;
+    // Sum of the sizes of the fixed size fields in front of this field.
+    uint32_t offset;
+    // Number of dynamic fields in front of this field.
+    uint32_t dynamic_rank;
+
+    bool isDynamic() const { return sizing != FIXED_SIZE; }
+    bool isArray() const { return kind == BASE_ARRAY || kind == MESSAGE_ARRAY; }
+    bool hasDynamicElements() const {
+      return sizing == STRINGS_SIZE || sizing == MESSAGES_SIZE;
     }
-    bool isDynamic();
-
-    static AccessPath advance(const AccessPath &path, size_t offset);
-    static AccessPath advance(
-        const AccessPath &path,
-        boost::function<size_t (const void *)> dynamic_offset);
-    
-   private:
-    size_t offset_;
-    boost::function<size_t (const void *)> dynamic_offset_;
   };
 
-  class CompiledField {
-   public:
-    CompiledField();
-    CompiledField(const CompiledField &src);
-    CompiledField(const Field &field, const AccessPath &path);
-    const Field &field() const { return *field_; }
-    const AccessPath &path() const { return path_; }
-
-   private:
-    const Field *field_;
-    const AccessPath path_;
-  };
+  CompiledMessage();
+  // Compiles message, interning names into strings. Sub-messages are
+  // looked up in pool.
+  CompiledMessage(
+      const MessagePool &pool, const boost::shared_ptr<StringTable> &strings,
+      const MessageType &type,
+      const boost::shared_ptr<const ParsedMessage> &message);
 
-  CompiledMessage() {}
-  CompiledMessage(const MessagePool &pool, const ParsedMessage &message);
-  size_t size(const void *data) const { path_to_next_.offset(data); }
-  const ParsedMessage &message() const { return message_; }
+  size_t size(const void *data) const {
+    return size_ + dynamicOffset(dynamic_fields_.size(), data);
+  }
+  bool isDynamic() const { return !dynamic_fields_.empty(); }
+  MessageType type() const;
+  // The definition this message was compiled from, shared with the pool.
+  const ParsedMessage &message() const { return *message_; }
+  // ROS compatible MD5 sum of the definition.
+  std::string fingerprint() const;
+  // Compiled fields in the order of message().fields.
+  const std::vector<CompiledField> &fields() const { return fields_; }
+  const char *fieldName(size_t field_index) const {
+    return strings_->str(fields_[field_index].name);
+  }
+  // Throws FieldNotFound if the message has no such field.
+  size_t fieldIndex(const std::string &field_name) const;
+  bool findField(const std::string &field_name, size_t *field_index) const;
+  // Offset of a field from the start of the message at data. data may be
+  // null if the field does not follow any dynamic fields.
+  size_t offset(size_t field_index, const void *data) const {
+    const CompiledField &field = fields_[field_index];
+    if (!field.dynamic_rank) {
+      return field.offset;
+    }
+    return field.offset + dynamicOffset(field.dynamic_rank, data);
+  }
+  size_t offset(const std::string &field_name, const void *data) const {
+    return offset(fieldIndex(field_name), data);
+  }
+  // Sum of the sizes of the first count dynamic fields of the message at
+  // data.
+  size_t dynamicOffset(size_t count, const void *data) const;
+  // Size of a field's data. data points to the start of the field and may
+  // be null if the field is not dynamic.
+  size_t fieldSize(size_t field_index, const void *data) const {
+    const CompiledField &field = fields_[field_index];
+    return field.isDynamic() ? dynamicSize(field, data) : field.size;
+  }
+  // Like size() and fieldSize() for data that is not trusted to be well
+  // formed: never reads past size bytes of data and throws InvalidMessage
+  // if the message or field does not fit.
+  size_t checkedSize(const void *data, size_t size) const;
+  size_t checkedFieldSize(
+      size_t field_index, const void *data, size_t size) const;
+  // The compiled message of a message field or the elements of a message
+  // array.
+  const CompiledMessage &subMessage(const CompiledField &field) const {
+    return *sub_messages_[field.message];
+  }
+  const StringTable &strings() const { return *strings_; }
+  // Compiles a nested path such as "pose.pose.position.x" or
+  // "transforms[0].header.stamp". Compiled paths are cached, so repeated
+  // lookups of the same path only cost a map lookup.
+  const FieldPath &fieldPath(const std::string &path) const;
+  // Bytes allocated by this message, not including its sub-messages and
+  // the string table.
+  size_t memoryUsage() const;
 
  private:
-  AccessPath path_to_next_;
-  std::map<std::string, AccessPath> field_access_paths_;
-  ParsedMessage message_;
+  struct FieldPathCache;
+
+  boost::shared_ptr<const StringTable> strings_;
+  boost::shared_ptr<const ParsedMessage> message_;
+  uint32_t package_;
+  uint32_t name_;
+  uint32_t fingerprint_;
+  // Sum of the sizes of all fixed size fields.
+  uint32_t size_;
+  std::vector<CompiledField> fields_;
+  // Indices of the dynamic fields in fields_.
+  std::vector<uint32_t> dynamic_fields_;
+  std::vector<boost::shared_ptr<const CompiledMessage> > sub_messages_;
+  // Statistics counters of the dynamic fields, empty unless statistics
+  // are enabled. Declared either way so that the layout of the class does
+  // not depend on the build option.
+  std::vector<size_t> counters_;
+  boost::shared_ptr<FieldPathCache> field_paths_;
+
+  size_t dynamicSize(const CompiledField &field, const void *data) const;
 };
 
 }  // namespace generic_message
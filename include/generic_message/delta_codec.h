@@ -0,0 +1,96 @@
+/**
+ * Copyright (c) 2013, Lorenz Moesenlechner <moesenle@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The names of the contributors may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <generic_message/compiled_message.h>
+
+namespace generic_message {
+
+class DeltaFailed : public std::runtime_error {
+ public:
+  DeltaFailed(const std::string &message)
+      : std::runtime_error(message) {}
+};
+
+// Encodes a message as the difference to a reference message of the same
+// type, typically the previous sample of a stream. Sub-messages are
+// flattened into their leaf fields; strings and arrays are compared as a
+// whole. A delta is a bitmap with one bit per leaf field, followed by the
+// serialized values of the fields that changed, in field order.
+//
+// Consecutive fixed size fields are compared as one block of 64 bit
+// words first, so unchanged runs such as poses and covariances cost a few
+// word compares and are only split into fields if they differ.
+class DeltaCodec {
+ public:
+  explicit DeltaCodec(const CompiledMessage &message);
+
+  // Number of leaf fields, i.e. bits in the bitmap.
+  size_t fieldCount() const { return field_sizes_.size(); }
+  size_t bitmapSize() const { return (field_sizes_.size() + 7) / 8; }
+
+  // Stores the difference of data to reference in delta and returns the
+  // number of changed fields.
+  size_t encode(
+      const void *reference, const void *data,
+      std::vector<uint8_t> *delta) const;
+  // Reconstructs the message that delta was encoded from and stores it in
+  // data. Returns the number of bytes of delta that were used. Throws
+  // DeltaFailed if delta is truncated.
+  size_t decode(
+      const void *reference, const void *delta, size_t size,
+      std::vector<uint8_t> *data) const;
+
+ private:
+  // Either a run of consecutive fixed size fields or a single dynamic
+  // field of message.
+  struct Segment {
+    const CompiledMessage *message;
+    uint32_t field;
+    uint32_t first_field;
+    uint32_t field_count;
+    // Size of fixed runs.
+    uint32_t size;
+  };
+
+  std::vector<Segment> segments_;
+  // Sizes of the leaf fields, zero for dynamic ones.
+  std::vector<uint32_t> field_sizes_;
+
+  void compile(const CompiledMessage &message);
+};
+
+}  // namespace generic_message
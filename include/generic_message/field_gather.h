@@ -0,0 +1,84 @@
+/**
+ * Copyright (c) 2013, Lorenz Moesenlechner <moesenle@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The names of the contributors may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <generic_message/compiled_message.h>
+#include <generic_message/field_path.h>
+
+namespace generic_message {
+
+class GatherFailed : public std::runtime_error {
+ public:
+  GatherFailed(const std::string &message)
+      : std::runtime_error(message) {}
+};
+
+// Copies one fixed size field, e.g. header.stamp, out of many buffers of
+// the same message type into a contiguous array. The path is resolved
+// once. If the field is at a fixed offset, buffers are walked with
+// software prefetching and 4 and 8 byte fields are loaded with AVX2
+// gathers on CPUs that support them; otherwise the offset is evaluated
+// per buffer.
+class FieldGather {
+ public:
+  // Throws GatherFailed if the path does not address a fixed size value.
+  FieldGather(const CompiledMessage &message, const std::string &path);
+
+  const FieldPath &path() const { return *path_; }
+  // Size of the field, i.e. bytes written per buffer.
+  size_t size() const { return size_; }
+
+  // Writes the field of buffers[i] to output + i * size().
+  void gather(const void *const *buffers, size_t count, void *output) const;
+  // Gathers into an array of T, which must have the size of the field.
+  template<typename T>
+  void gather(
+      const std::vector<const void *> &buffers, std::vector<T> *output) const {
+    if (sizeof(T) != size_) {
+      throw GatherFailed(path_->path() + " does not have the size of T");
+    }
+    output->resize(buffers.size());
+    if (!buffers.empty()) {
+      gather(&buffers[0], buffers.size(), &(*output)[0]);
+    }
+  }
+
+ private:
+  const FieldPath *path_;
+  size_t size_;
+};
+
+}  // namespace generic_message
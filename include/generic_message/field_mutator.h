@@ -0,0 +1,116 @@
+/**
+ * Copyright (c) 2013, Lorenz Moesenlechner <moesenle@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The names of the contributors may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <generic_message/compiled_message.h>
+#include <generic_message/field_path.h>
+#include <generic_message/message_buffer.h>
+
+namespace generic_message {
+
+class MutationFailed : public std::runtime_error {
+ public:
+  MutationFailed(const std::string &message)
+      : std::runtime_error(message) {}
+};
+
+// Changes one field of serialized messages without decoding them, e.g. to
+// rewrite header.frame_id and header.stamp in a relay. Fixed size fields
+// are overwritten in place. Strings and arrays are resized by moving the
+// rest of the message once, so a mutation costs the bytes behind the
+// field rather than the whole message. The path is resolved once with
+// CompiledMessage::fieldPath.
+class FieldMutator {
+ public:
+  FieldMutator(const CompiledMessage &message, const std::string &path);
+
+  const FieldPath &path() const { return *path_; }
+
+  // Overwrites a fixed size field. Throws MutationFailed if the field is
+  // dynamic or its size differs from sizeof(T).
+  template<typename T>
+  void set(void *data, const T &value) const {
+    checkFixed(sizeof(T));
+    memcpy(reinterpret_cast<uint8_t *>(data) + path_->offset(data), &value,
+           sizeof(T));
+  }
+  // Overwrites a time or duration field.
+  void setTime(void *data, uint32_t sec, uint32_t nsec) const;
+
+  // Replaces the value of a string field, or of an element of a string
+  // array.
+  void setString(MessageBuffer *buffer, const std::string &value) const;
+  void setString(std::vector<uint8_t> *buffer, const std::string &value) const;
+  // Replaces the elements of an array of fixed size elements. count must
+  // match the length of fixed length arrays.
+  void setArray(
+      MessageBuffer *buffer, const void *elements, size_t count) const;
+  void setArray(
+      std::vector<uint8_t> *buffer, const void *elements, size_t count) const;
+  // Replaces the field with size bytes of its serialized form. Works for
+  // any field, e.g. arrays of strings; value must be well formed.
+  void replace(MessageBuffer *buffer, const void *value, size_t size) const;
+  void replace(
+      std::vector<uint8_t> *buffer, const void *value, size_t size) const;
+
+ private:
+  typedef enum {
+    // Fixed size fields, elements and fixed length arrays.
+    FIXED,
+    STRING,
+    // Length prefixed arrays of fixed size elements.
+    ARRAY,
+    // Everything else, which can only be replaced.
+    OTHER
+  } mutation_kind;
+
+  const FieldPath *path_;
+  mutation_kind kind_;
+  // Size of fixed fields and size of the elements of arrays.
+  size_t size_;
+  size_t element_size_;
+
+  void checkFixed(size_t size) const;
+  template<typename Buffer>
+  uint8_t *resize(Buffer *buffer, size_t size) const;
+  template<typename Buffer>
+  void writeString(Buffer *buffer, const std::string &value) const;
+  template<typename Buffer>
+  void writeArray(Buffer *buffer, const void *elements, size_t count) const;
+};
+
+}  // namespace generic_message
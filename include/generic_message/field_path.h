@@ -0,0 +1,118 @@
+/**
+ * Copyright (c) 2013, Lorenz Moesenlechner <moesenle@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The names of the contributors may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <generic_message/compiled_message.h>
+#include <generic_message/parsed_message.h>
+
+namespace generic_message {
+
+class IndexOutOfRange : public std::runtime_error {
+ public:
+  IndexOutOfRange(const std::string &message)
+      : std::runtime_error(message) {}
+};
+
+// A field path such as "transforms[0].header.stamp" compiled into an
+// access program. Offsets that do not depend on the data are folded into
+// constants, so a path that only crosses fixed size fields costs a single
+// addition. A path refers to the sub-messages of the message it was
+// compiled for and must not outlive it.
+class FieldPath {
+ public:
+  FieldPath(const CompiledMessage &message, const std::string &path);
+
+  size_t offset(const void *data) const {
+    if (steps_.empty()) {
+      return offset_;
+    }
+    return evaluate(data);
+  }
+  // Size of the addressed field or array element in the message at data.
+  size_t size(const void *data) const;
+  bool isDynamic() const { return !steps_.empty(); }
+  const std::string &path() const { return path_; }
+  // The type of the addressed field. Indexing an array yields the
+  // element type.
+  const Type &type() const { return type_; }
+  // The compiled field the path ends in. If the path ends with an index,
+  // this is the array and the path addresses one of its elements.
+  const CompiledMessage::CompiledField &field() const {
+    return message_->fields()[field_];
+  }
+  bool isElement() const { return element_; }
+  size_t memoryUsage() const;
+
+ private:
+  struct Step {
+    typedef enum {
+      // Add the sizes of the first index dynamic fields of message.
+      FIELD,
+      // Check the length prefix of an array against index.
+      CHECK_LENGTH,
+      // Skip index strings.
+      SKIP_STRINGS,
+      // Skip index messages.
+      SKIP_MESSAGES
+    } step_kind;
+
+    step_kind kind;
+    const CompiledMessage *message;
+    uint32_t index;
+    // Constant added after the step has been evaluated.
+    size_t offset;
+
+    Step(step_kind kind)
+        : kind(kind), message(0), index(0), offset(0) {}
+  };
+
+  std::string path_;
+  Type type_;
+  size_t offset_;
+  // Message and index of the last field of the path.
+  const CompiledMessage *message_;
+  uint32_t field_;
+  bool element_;
+  std::vector<Step> steps_;
+
+  size_t evaluate(const void *data) const;
+  void addOffset(size_t offset);
+  void addIndex(
+      const CompiledMessage &message,
+      const CompiledMessage::CompiledField &field, size_t index);
+};
+
+}  // namespace generic_message
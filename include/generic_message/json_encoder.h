@@ -0,0 +1,102 @@
+/**
+ * Copyright (c) 2013, Lorenz Moesenlechner <moesenle@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The names of the contributors may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <generic_message/compiled_message.h>
+
+namespace generic_message {
+
+class EncodingFailed : public std::runtime_error {
+ public:
+  EncodingFailed(const std::string &message)
+      : std::runtime_error(message) {}
+};
+
+// A value of a JSON document. Containers are followed by their contents,
+// object members by a key token and the member's value.
+struct JsonToken {
+  typedef enum {
+    OBJECT, ARRAY, STRING, NUMBER, TRUE_VALUE, FALSE_VALUE, NULL_VALUE
+  } token_type;
+
+  uint8_t type;
+  // Strings with escape sequences need to be decoded.
+  bool escaped;
+  // The text of the value, without quotes for strings.
+  uint32_t begin;
+  uint32_t length;
+  // Members of objects, elements of arrays and the decoded length of
+  // strings.
+  uint32_t count;
+  // Index of the token that follows the value and its contents.
+  uint32_t next;
+};
+
+// Encodes JSON documents into serialized messages. The document is
+// tokenized once into a flat token array. A first pass over the tokens
+// computes the exact size of the message and validates the document, and
+// a second pass writes the fields in the order of the message definition,
+// so encoding allocates the output at most once.
+//
+// Members that are missing from the document are encoded as zero, empty
+// strings and empty arrays; unknown members are an error. Numeric fields
+// accept the names of the message's constants as values, uint8 and int8
+// arrays also accept base64 strings, floating point fields accept null as
+// NaN, and time and duration fields are objects with the members sec and
+// nsec (or secs and nsecs).
+//
+// An encoder keeps its token array between calls and is not thread-safe.
+class JsonEncoder {
+ public:
+  JsonEncoder();
+
+  // Replaces the contents of output with the encoded message. Throws
+  // EncodingFailed if json is not a valid document for message. output is
+  // unchanged on failure.
+  void encode(
+      const CompiledMessage &message, const std::string &json,
+      std::vector<uint8_t> *output);
+  void encode(
+      const CompiledMessage &message, const char *json, size_t length,
+      std::vector<uint8_t> *output);
+
+ private:
+  std::vector<JsonToken> tokens_;
+  // Scratch space to decode object keys with escape sequences.
+  std::string key_;
+};
+
+}  // namespace generic_message
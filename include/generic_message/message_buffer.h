@@ -0,0 +1,69 @@
+/**
+ * Copyright (c) 2013, Lorenz Moesenlechner <moesenle@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The names of the contributors may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+namespace generic_message {
+
+// A serialized message with spare capacity behind it, so that growing a
+// field with FieldMutator does not reallocate on every mutation. When it
+// has to grow, the buffer reserves a quarter of its size on top and
+// copies head and tail straight to their new places.
+class MessageBuffer {
+ public:
+  // Spare capacity reserved by assign().
+  static const size_t kDefaultSlack = 64;
+
+  MessageBuffer() : size_(0) {}
+  MessageBuffer(const void *data, size_t size, size_t slack = kDefaultSlack);
+
+  uint8_t *data() { return bytes_.empty() ? 0 : &bytes_[0]; }
+  const uint8_t *data() const { return bytes_.empty() ? 0 : &bytes_[0]; }
+  size_t size() const { return size_; }
+  size_t capacity() const { return bytes_.size(); }
+
+  void assign(const void *data, size_t size, size_t slack = kDefaultSlack);
+  void reserve(size_t capacity);
+  // Replaces the old_size bytes at offset with new_size bytes by moving the
+  // rest of the message once and returns a pointer to them. Bytes that
+  // were added are uninitialized.
+  uint8_t *splice(size_t offset, size_t old_size, size_t new_size);
+
+ private:
+  // The message followed by the spare capacity.
+  std::vector<uint8_t> bytes_;
+  size_t size_;
+};
+
+}  // namespace generic_message
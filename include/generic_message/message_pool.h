@@ -29,12 +29,20 @@
 
 #pragma once
 
+#include <stdint.h>
+
 #include <stdexcept>
-#include <map>
+#include <set>
 #include <string>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/recursive_mutex.hpp>
+#include <boost/unordered_map.hpp>
 
 #include <generic_message/parsed_message.h>
 #include <generic_message/compiled_message.h>
+#include <generic_message/string_table.h>
 
 namespace generic_message {
 
@@ -50,21 +58,106 @@ class MessageNotFound : public std::runtime_error {
       : std::runtime_error(message) {}
 };
 
+// Message definitions are only registered by add and compiled when they
+// are first requested, so definitions may be added in any order. Adding a
+// definition again discards the compiled versions of the message and of
+// all messages that depend on it; they are recompiled on their next use.
+//
+// Package, type and field names are interned in a string table that is
+// shared by all messages of a pool, and messages are referenced by the
+// ids of their names.
 class MessagePool {
  public:
+  // Approximate number of bytes allocated by a pool.
+  struct MemoryUsage {
+    size_t strings;
+    size_t string_bytes;
+    size_t definitions;
+    // Parsed definitions, dependency graph and fingerprint index.
+    size_t definition_bytes;
+    size_t compiled_messages;
+    size_t compiled_fields;
+    // Compiled messages, including their cached field paths.
+    size_t compiled_bytes;
+
+    MemoryUsage()
+        : strings(0), string_bytes(0), definitions(0), definition_bytes(0),
+          compiled_messages(0), compiled_fields(0), compiled_bytes(0) {}
+    size_t total() const {
+      return string_bytes + definition_bytes + compiled_bytes;
+    }
+  };
+
+  MessagePool();
   void add(
       const std::string &package, const std::string &name,
       const ParsedMessage &message);
   void add(
       const std::string &package, const std::string &name,
       const std::string &description);
+  // The returned reference stays valid until the message or one of its
+  // dependencies is added again. Use getShared to keep a compiled message
+  // alive beyond that.
   const CompiledMessage &get(
       const std::string &package, const std::string &name) const;
+  boost::shared_ptr<const CompiledMessage> getShared(
+      const std::string &package, const std::string &name) const;
+  // Looks up a message by its MD5 sum. Types with equal MD5 sums have
+  // equal field names and layouts, so any of them is returned.
+  const CompiledMessage &getByFingerprint(const std::string &fingerprint) const;
+  // MD5 sum of a message, computed from the definitions without compiling
+  // them.
+  std::string fingerprint(
+      const std::string &package, const std::string &name) const;
+  MemoryUsage memoryUsage() const;
+
  private:
-  std::map<std::string, CompiledMessage> known_messages_;
+  // Messages are identified by the id of "<package>/<name>" in strings_.
+  struct Definition {
+    // Whether all dependencies of a message are defined, recursively.
+    typedef enum {
+      UNKNOWN, COMPLETE, INCOMPLETE
+    } completeness_kind;
 
-  std::string make_key(
-      const std::string &package, const std::string &name) const;
+    uint32_t package;
+    uint32_t name;
+    boost::shared_ptr<const ParsedMessage> message;
+    std::vector<uint32_t> dependencies;
+    boost::shared_ptr<const CompiledMessage> compiled;
+    // Id of the MD5 sum in strings_, StringTable::kNotFound until it has
+    // been computed.
+    uint32_t fingerprint;
+    completeness_kind completeness;
+    // Guards against recursive definitions.
+    bool compiling;
+    bool fingerprinting;
+
+    Definition()
+        : package(StringTable::kNotFound), name(StringTable::kNotFound),
+          fingerprint(StringTable::kNotFound), completeness(UNKNOWN),
+          compiling(false), fingerprinting(false) {}
+  };
+
+  mutable boost::recursive_mutex mutex_;
+  boost::shared_ptr<StringTable> strings_;
+  mutable boost::unordered_map<uint32_t, Definition> definitions_;
+  // The messages that use a message, by the id of that message.
+  boost::unordered_map<uint32_t, std::vector<uint32_t> > dependents_;
+  // Message ids by the ids of their fingerprints.
+  mutable boost::unordered_multimap<uint32_t, uint32_t> fingerprints_;
+  // Complete messages whose fingerprints are not in fingerprints_ yet.
+  // Messages with missing dependencies are added once the last one is
+  // defined, so lookups never retry them.
+  mutable std::set<uint32_t> unindexed_;
+
+  uint32_t makeKey(const std::string &package, const std::string &name);
+  uint32_t lookup(const std::string &package, const std::string &name) const;
+  Definition &find(uint32_t id) const;
+  const boost::shared_ptr<const CompiledMessage> &compile(uint32_t id) const;
+  uint32_t fingerprint(uint32_t id) const;
+  void indexFingerprints() const;
+  bool checkComplete(uint32_t id);
+  void invalidate(uint32_t id);
 };
 
 }  // namespace generic_message
@@ -0,0 +1,73 @@
+/**
+ * Copyright (c) 2013, Lorenz Moesenlechner <moesenle@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The names of the contributors may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <string>
+
+#include <generic_message/compiled_message.h>
+
+namespace generic_message {
+
+// Prints serialized messages as YAML or as single line JSON, walking the
+// data with the message's compiled fields. time and duration values are
+// printed as messages with the fields sec and nsec. Arrays with more than
+// max_array_length elements are truncated and end with a string that
+// tells how many elements were left out.
+//
+// Printing appends to a string that is reused between calls, so printing
+// a stream of messages does not allocate once the buffer has grown to the
+// size of the largest message. Like the other accessors, the printer
+// trusts the data to match the message.
+class MessagePrinter {
+ public:
+  typedef enum {
+    YAML,
+    JSON
+  } format_type;
+
+  // A max_array_length of zero prints all elements.
+  explicit MessagePrinter(
+      format_type format = YAML, size_t max_array_length = 0);
+
+  // Returns the text of the message at data. The text is only valid until
+  // the next call.
+  const std::string &print(const CompiledMessage &message, const void *data);
+  // Appends the text of the message at data to output.
+  void print(
+      const CompiledMessage &message, const void *data,
+      std::string *output) const;
+
+ private:
+  format_type format_;
+  size_t max_array_length_;
+  std::string buffer_;
+};
+
+}  // namespace generic_message
@@ -0,0 +1,255 @@
+/**
+ * Copyright (c) 2013, Lorenz Moesenlechner <moesenle@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The names of the contributors may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#include <generic_message/compiled_message.h>
+#include <generic_message/parsed_message.h>
+
+namespace generic_message {
+
+struct StringValue {
+  const char *data;
+  size_t size;
+};
+
+struct TimeValue {
+  uint32_t sec;
+  uint32_t nsec;
+};
+
+struct DurationValue {
+  int32_t sec;
+  int32_t nsec;
+};
+
+// Default callbacks for traverse(). Visitors derive from it and redeclare
+// the callbacks they are interested in; since traverse() is instantiated
+// for the derived type, the callbacks are resolved statically and inline.
+//
+// Declaring any value() in a visitor hides all overloads of the base
+// class, so other types would be converted to the declared ones or fail
+// to compile. Visitors that handle only some types must bring the
+// defaults back into scope:
+//
+//   class FloatVisitor : public TraversalVisitor {
+//    public:
+//     using TraversalVisitor::value;
+//     void value(float value);
+//     void value(double value);
+//   };
+//
+// A template
+//
+//   template<typename T> void value(T value);
+//
+// instead replaces all value callbacks at once.
+class TraversalVisitor {
+ public:
+  typedef CompiledMessage::CompiledField CompiledField;
+
+  void beginMessage(const CompiledMessage &) {}
+  void endMessage(const CompiledMessage &) {}
+  // Returning false skips the field. Fixed size fields, including
+  // sub-messages and arrays of any depth, are skipped with one addition.
+  bool beginField(const CompiledMessage &, size_t) { return true; }
+  void endField(const CompiledMessage &, size_t) {}
+  void beginArray(const CompiledMessage &, const CompiledField &, size_t) {}
+  void endArray(const CompiledMessage &, const CompiledField &) {}
+  // Called before every element of an array.
+  void element(size_t) {}
+  // Arrays of numbers are offered as a whole first. Returning true skips
+  // the callbacks for their elements, e.g. to copy them in bulk.
+  bool arrayData(const CompiledField &, const void *, size_t) {
+    return false;
+  }
+
+  void value(bool) {}
+  void value(int8_t) {}
+  void value(uint8_t) {}
+  void value(int16_t) {}
+  void value(uint16_t) {}
+  void value(int32_t) {}
+  void value(uint32_t) {}
+  void value(int64_t) {}
+  void value(uint64_t) {}
+  void value(float) {}
+  void value(double) {}
+  void value(const StringValue &) {}
+  void value(const TimeValue &) {}
+  void value(const DurationValue &) {}
+};
+
+// Walks every leaf value of the serialized message at data and returns
+// the size of the message. Fields are visited in order; sub-messages are
+// enclosed by beginMessage and endMessage, arrays by beginArray and
+// endArray. Like the other accessors, the traversal trusts the data to
+// match the message.
+template<typename Visitor>
+size_t traverse(
+    const CompiledMessage &message, const void *data, Visitor *visitor);
+
+template<typename Visitor>
+class MessageTraversal {
+ public:
+  typedef CompiledMessage::CompiledField CompiledField;
+
+  static const uint8_t *message(
+      const CompiledMessage &message, const uint8_t *data, Visitor *visitor) {
+    const std::vector<CompiledField> &fields = message.fields();
+    visitor->beginMessage(message);
+    for (size_t i = 0; i < fields.size(); i++) {
+      const CompiledField &field = fields[i];
+      if (!visitor->beginField(message, i)) {
+        data += field.isDynamic() ? message.fieldSize(i, data) : field.size;
+        continue;
+      }
+      data = MessageTraversal::field(message, field, data, visitor);
+      visitor->endField(message, i);
+    }
+    visitor->endMessage(message);
+    return data;
+  }
+
+ private:
+  template<typename T>
+  static T read(const uint8_t *data) {
+    T value;
+    memcpy(&value, data, sizeof(T));
+    return value;
+  }
+
+  static const uint8_t *field(
+      const CompiledMessage &message, const CompiledField &field,
+      const uint8_t *data, Visitor *visitor) {
+    switch (field.kind) {
+      case CompiledField::BASE:
+        return leaf(field.base_type, data, visitor);
+      case CompiledField::MESSAGE:
+        return MessageTraversal::message(
+            message.subMessage(field), data, visitor);
+      default:
+        break;
+    }
+    size_t count = field.array_length;
+    if (count == CompiledField::kUnbounded) {
+      count = read<uint32_t>(data);
+      data += 4;
+    }
+    visitor->beginArray(message, field, count);
+    if (field.kind == CompiledField::BASE_ARRAY) {
+      if (field.base_type != BaseType::STRING &&
+          visitor->arrayData(field, data, count)) {
+        data += count * field.element_size;
+      } else {
+        for (size_t i = 0; i < count; i++) {
+          visitor->element(i);
+          data = leaf(field.base_type, data, visitor);
+        }
+      }
+    } else {
+      const CompiledMessage &element = message.subMessage(field);
+      for (size_t i = 0; i < count; i++) {
+        visitor->element(i);
+        data = MessageTraversal::message(element, data, visitor);
+      }
+    }
+    visitor->endArray(message, field);
+    return data;
+  }
+
+  static const uint8_t *leaf(
+      uint8_t type, const uint8_t *data, Visitor *visitor) {
+    switch (type) {
+      case BaseType::BOOL:
+        visitor->value(read<uint8_t>(data) != 0);
+        return data + 1;
+      case BaseType::INT8:
+        visitor->value(read<int8_t>(data));
+        return data + 1;
+      case BaseType::UINT8:
+        visitor->value(read<uint8_t>(data));
+        return data + 1;
+      case BaseType::INT16:
+        visitor->value(read<int16_t>(data));
+        return data + 2;
+      case BaseType::UINT16:
+        visitor->value(read<uint16_t>(data));
+        return data + 2;
+      case BaseType::INT32:
+        visitor->value(read<int32_t>(data));
+        return data + 4;
+      case BaseType::UINT32:
+        visitor->value(read<uint32_t>(data));
+        return data + 4;
+      case BaseType::INT64:
+        visitor->value(read<int64_t>(data));
+        return data + 8;
+      case BaseType::UINT64:
+        visitor->value(read<uint64_t>(data));
+        return data + 8;
+      case BaseType::FLOAT32:
+        visitor->value(read<float>(data));
+        return data + 4;
+      case BaseType::FLOAT64:
+        visitor->value(read<double>(data));
+        return data + 8;
+      case BaseType::STRING: {
+        StringValue value = {
+          reinterpret_cast<const char *>(data + 4), read<uint32_t>(data)};
+        visitor->value(value);
+        return data + 4 + value.size;
+      }
+      case BaseType::TIME: {
+        TimeValue value = {read<uint32_t>(data), read<uint32_t>(data + 4)};
+        visitor->value(value);
+        return data + 8;
+      }
+      case BaseType::DURATION: {
+        DurationValue value = {read<int32_t>(data), read<int32_t>(data + 4)};
+        visitor->value(value);
+        return data + 8;
+      }
+      default:
+        return data;
+    }
+  }
+};
+
+template<typename Visitor>
+size_t traverse(
+    const CompiledMessage &message, const void *data, Visitor *visitor) {
+  const uint8_t *begin = reinterpret_cast<const uint8_t *>(data);
+  return MessageTraversal<Visitor>::message(message, begin, visitor) - begin;
+}
+
+}  // namespace generic_message
@@ -29,7 +29,10 @@
 
 #pragma once
 
+#include <string>
+
 #include <boost/foreach.hpp>
+#include <boost/lexical_cast.hpp>
 
 #include <generic_message/parsed_message.h>
 #include <generic_message/message_pool.h>
@@ -57,6 +60,27 @@ struct MessageTypeTraits<BaseType> {
       return false;
     }
   }
+  static size_t fixedSize(const MessagePool &, const BaseType &type) {
+    switch (type.type) {
+      case BaseType::BOOL:
+      case BaseType::INT8:
+      case BaseType::UINT8: return 1;
+      case BaseType::INT16:
+      case BaseType::UINT16: return 2;
+      case BaseType::INT32:
+      case BaseType::UINT32:
+      case BaseType::FLOAT32: return 4;
+      case BaseType::INT64:
+      case BaseType::UINT64:
+      case BaseType::FLOAT64: return 8;
+      case BaseType::TIME:
+      case BaseType::DURATION: return 8;
+      default:
+        throw CompilationFailed(
+            "Not a fixed size type type: " +
+            boost::lexical_cast<std::string>(type.type));
+    }
+  }
 };
 
 template<typename T>
@@ -64,6 +88,12 @@ struct MessageTypeTraits<ArrayType<T> > {
   static bool isDynamic(const MessagePool &pool, const ArrayType<T> &type) {
     return !type.size || MessageTypeTraits<T>::isDynamic(pool, type.type);
   }
+  static size_t fixedSize(const MessagePool &pool, const ArrayType<T> &type) {
+    if (!type.size) {
+      throw CompilationFailed("Not a fixed size array");
+    }
+    return *type.size * MessageTypeTraits<T>::fixedSize(pool, type.type);
+  }
 };
 
 template<>
@@ -88,8 +118,11 @@ struct MessageTypeTraits<ParsedMessage> {
 template<>
 struct MessageTypeTraits<MessageType> {
   static bool isDynamic(const MessagePool &pool, const MessageType &type) {
-    return MessageTypeTraits<ParsedMessage>::isDynamic(
-        pool, pool.get(type.package, type.name).message());
+    return pool.get(type.package, type.name).isDynamic();
+  }
+  static size_t fixedSize(const MessagePool &pool, const MessageType &type) {
+    // Messages without dynamic fields do not need data to be sized.
+    return pool.get(type.package, type.name).size(0);
   }
 };
 
@@ -98,6 +131,13 @@ bool isDynamic(const MessagePool &pool, const T &type) {
   return MessageTypeTraits<T>::isDynamic(pool, type);
 }
 
+// Size of a type that is not dynamic. Throws CompilationFailed for
+// dynamic base types and arrays of unspecified length.
+template<typename T>
+size_t fixedSize(const MessagePool &pool, const T &type) {
+  return MessageTypeTraits<T>::fixedSize(pool, type);
+}
+
 template<typename T>
 struct native_base_type {
 };
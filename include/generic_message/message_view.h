@@ -0,0 +1,111 @@
+/**
+ * Copyright (c) 2013, Lorenz Moesenlechner <moesenle@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The names of the contributors may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include <generic_message/compiled_message.h>
+
+namespace generic_message {
+
+// A message buffer together with its compiled description. The view
+// remembers every field offset it computes, so reading a field only walks
+// the fields between the furthest offset known so far and the requested
+// field instead of starting at the beginning of the message. Fields in
+// front of the first dynamic field are read at their compiled offsets
+// without walking; a walk stores the offset of every field it passes,
+// fixed or dynamic. Offsets of messages with fewer than kInlineOffsets
+// fields are kept inline and do not allocate.
+//
+// Views are cheap to create but not thread-safe.
+class MessageView {
+ public:
+  static const size_t kInlineOffsets = 16;
+
+  MessageView(const CompiledMessage &message, const void *data);
+  MessageView(const MessageView &other);
+  MessageView &operator=(const MessageView &other);
+
+  // Points the view at another message, keeping the memory of its offset
+  // table so that views reused in a loop do not allocate.
+  void reset(const CompiledMessage &message, const void *data);
+
+  const CompiledMessage &message() const { return *message_; }
+  const void *data() const { return data_; }
+
+  size_t offset(size_t field_index) const {
+    const CompiledMessage::CompiledField &field =
+        message_->fields()[field_index];
+    if (!field.dynamic_rank) {
+      return field.offset;
+    }
+    if (field_index < known_) {
+      return offsets_[field_index];
+    }
+    return walk(field_index);
+  }
+  size_t offset(const std::string &field_name) const {
+    return offset(message_->fieldIndex(field_name));
+  }
+  const void *field(size_t field_index) const {
+    return data_ + offset(field_index);
+  }
+  template<typename T>
+  T value(size_t field_index) const {
+    T result;
+    memcpy(&result, field(field_index), sizeof(T));
+    return result;
+  }
+  size_t size() const {
+    size_t end = message_->fields().size();
+    return end < known_ ? offsets_[end] : walk(end);
+  }
+
+ private:
+  const CompiledMessage *message_;
+  const uint8_t *data_;
+  // Number of leading fields whose offsets are stored in offsets_.
+  mutable size_t known_;
+  // Offsets of the fields followed by the end of the message. Points to
+  // inline_offsets_ until more than kInlineOffsets entries are needed.
+  mutable size_t *offsets_;
+  mutable size_t inline_offsets_[kInlineOffsets];
+  mutable std::vector<size_t> heap_offsets_;
+
+  size_t walk(size_t field_index) const;
+  void reserve(size_t count) const;
+  void assign(const MessageView &other);
+};
+
+}  // namespace generic_message
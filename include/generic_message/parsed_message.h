@@ -89,14 +89,22 @@ struct Constant {
   Type type;
   std::string name;
   ConstantValueType value;
+  // The value as written in the definition, used to compute fingerprints.
+  std::string text;
 
   Constant() {}
 
   Constant(const Type &type, const std::string &name, std::string &value)
-      : type(type), name(name), value(boost::algorithm::trim_copy(value)) {};
+      : type(type), name(name), value(boost::algorithm::trim_copy(value)),
+        text(boost::algorithm::trim_copy(value)) {};
   template<typename T>
   Constant(const Type &type, const std::string &name, T &value)
       : type(type), name(name), value(value) {};
+  template<typename T>
+  Constant(
+      const Type &type, const std::string &name, const T &value,
+      const std::string &text)
+      : type(type), name(name), value(value), text(text) {};
 };
   
 struct Field {
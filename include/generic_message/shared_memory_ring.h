@@ -0,0 +1,169 @@
+/**
+ * Copyright (c) 2013, Lorenz Moesenlechner <moesenle@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The names of the contributors may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+#include <generic_message/compiled_message.h>
+
+namespace generic_message {
+
+class RingError : public std::runtime_error {
+ public:
+  RingError(const std::string &message)
+      : std::runtime_error(message) {}
+};
+
+// A mapping of a POSIX shared memory object or memfd.
+class SharedMemory : private boost::noncopyable {
+ public:
+  // Creates the shared memory object name, or an anonymous memfd if name
+  // is empty. Throws RingError if the object already exists. The object
+  // is unlinked again when the mapping is destroyed.
+  SharedMemory(const std::string &name, size_t size);
+  // Maps an existing object read-only, either by name or by a file
+  // descriptor, which is duplicated.
+  explicit SharedMemory(const std::string &name);
+  explicit SharedMemory(int fd);
+  ~SharedMemory();
+
+  // Unlinks the shared memory object name, e.g. one left behind by a
+  // writer that crashed. Returns false if there is no such object.
+  static bool remove(const std::string &name);
+
+  int fd() const { return fd_; }
+  uint8_t *data() const { return data_; }
+  size_t size() const { return size_; }
+
+ private:
+  std::string name_;
+  int fd_;
+  uint8_t *data_;
+  size_t size_;
+  bool owner_;
+
+  void map(bool writable);
+};
+
+// Single producer, multiple consumer ring of serialized messages in shared
+// memory. The ring consists of slot_count slots of slot_size bytes each
+// and records the fingerprint of the message type it carries, so readers
+// of a different schema are rejected when they attach.
+//
+// Every slot carries a sequence counter that is odd while the writer
+// fills it and holds the message number once it is published. The writer
+// never waits for readers: readers that fall behind by more than
+// slot_count messages skip the overwritten ones, and a reader can check
+// after using a message in place whether the writer has reused its slot
+// in the meantime.
+class RingWriter : private boost::noncopyable {
+ public:
+  // Creates the ring in the shared memory object name, or in an
+  // anonymous memfd if name is empty. Throws RingError if slot_count or
+  // slot_size is zero or the ring does not fit into memory.
+  RingWriter(
+      const std::string &name, const CompiledMessage &message,
+      size_t slot_count, size_t slot_size);
+
+  const SharedMemory &memory() const { return memory_; }
+  size_t slotSize() const { return slot_size_; }
+  // Number of published messages.
+  uint64_t sequence() const { return sequence_; }
+
+  // Returns the slot for the next message, which the caller serializes in
+  // place and publishes with commit(). Throws RingError if size exceeds
+  // the slot size.
+  void *reserve(size_t size);
+  void commit();
+  // Copies a serialized message into the ring and publishes it.
+  void write(const void *data, size_t size);
+
+ private:
+  SharedMemory memory_;
+  size_t slot_count_;
+  size_t slot_size_;
+  uint64_t sequence_;
+  bool reserved_;
+  size_t reserved_size_;
+};
+
+// A message read from a ring. The data stays in shared memory.
+struct RingMessage {
+  const void *data;
+  size_t size;
+  // Number of the message, counting from zero.
+  uint64_t sequence;
+
+  RingMessage() : data(0), size(0), sequence(0) {}
+};
+
+class RingReader : private boost::noncopyable {
+ public:
+  // Attaches to the ring in the shared memory object name or the file
+  // descriptor fd. Throws RingError if the ring carries a different
+  // message type. Reading starts with the next published message.
+  RingReader(const std::string &name, const CompiledMessage &message);
+  RingReader(int fd, const CompiledMessage &message);
+
+  // Returns the next message or false if there is none. Messages are
+  // validated against the compiled message and invalid ones throw
+  // InvalidMessage. The data stays in the slot, and the writer may
+  // overwrite it at any time, so isCurrent() can only tell after the fact
+  // whether it was intact. Reads of torn data may follow lengths that the
+  // writer is rewriting, so access the data only with checked accessors
+  // such as CompiledMessage::checkedSize, bounded by size.
+  bool read(RingMessage *message);
+  // Copies the next intact message into data, which can then be accessed
+  // like any other buffer. Stores its number in sequence if not null.
+  bool read(std::vector<uint8_t> *data, uint64_t *sequence = 0);
+  // True if the writer has not started to overwrite message since it was
+  // read. Check after using the data in place to detect torn reads.
+  bool isCurrent(const RingMessage &message) const;
+  // Number of messages that were overwritten before they could be read.
+  uint64_t dropped() const { return dropped_; }
+
+ private:
+  const CompiledMessage *message_;
+  SharedMemory memory_;
+  size_t slot_count_;
+  size_t slot_size_;
+  uint64_t next_;
+  uint64_t dropped_;
+
+  void attach();
+};
+
+}  // namespace generic_message
@@ -0,0 +1,136 @@
+/**
+ * Copyright (c) 2013, Lorenz Moesenlechner <moesenle@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The names of the contributors may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <map>
+#include <string>
+
+#include <boost/atomic.hpp>
+
+// Statistics are only collected when the library is built with
+// GENERIC_MESSAGE_ENABLE_STATISTICS defined. Otherwise all counting macros
+// expand to nothing and snapshots are empty.
+#ifdef GENERIC_MESSAGE_ENABLE_STATISTICS
+#define GENERIC_MESSAGE_COUNT(counter, value) \
+  ::generic_message::statistics::add((counter), (value))
+#else
+#define GENERIC_MESSAGE_COUNT(counter, value) ((void) 0)
+#endif
+
+namespace generic_message {
+
+struct Statistics {
+  uint64_t pool_get_calls;
+  uint64_t pool_get_misses;
+  uint64_t dynamic_offset_evaluations;
+  uint64_t bytes_walked;
+  // Dynamic offset evaluations keyed by "<package>/<name>.<field>", the
+  // field whose size had to be computed from the data.
+  std::map<std::string, uint64_t> dynamic_offset_evaluations_by_field;
+  // Number of compilations and accumulated compile time keyed by
+  // "<package>/<name>".
+  std::map<std::string, uint64_t> compilations;
+  std::map<std::string, uint64_t> compile_time_ns;
+
+  Statistics()
+      : pool_get_calls(0), pool_get_misses(0),
+        dynamic_offset_evaluations(0), bytes_walked(0) {}
+};
+
+bool statisticsEnabled();
+
+// Sums the counters of all threads, including threads that already
+// exited, since the last call to resetStatistics.
+Statistics statisticsSnapshot();
+void resetStatistics();
+
+namespace statistics {
+
+typedef enum {
+  POOL_GET_CALLS,
+  POOL_GET_MISSES,
+  DYNAMIC_OFFSET_EVALUATIONS,
+  BYTES_WALKED,
+  FIELD_DYNAMIC_OFFSET_EVALUATIONS,
+  TYPE_COMPILATIONS,
+  TYPE_COMPILE_TIME_NS
+} counter_kind;
+
+const size_t kChunkSize = 256;
+const size_t kMaxChunks = 256;
+
+struct Chunk {
+  boost::atomic<uint64_t> values[kChunkSize];
+  Chunk();
+};
+
+// Counters are only ever written by the thread that owns them, so
+// incrementing them is a plain load and store. The atomics make it safe
+// for snapshots to read them concurrently.
+struct ThreadCounters {
+  boost::atomic<Chunk *> chunks[kMaxChunks];
+  ThreadCounters();
+  ~ThreadCounters();
+};
+
+extern __thread ThreadCounters *thread_counters;
+
+// Returns the id of the counter of the given kind and name, registering
+// it if necessary. Global counters use an empty name.
+size_t registerCounter(counter_kind kind, const std::string &name);
+
+ThreadCounters *initializeThread();
+Chunk *allocateChunk(ThreadCounters *counters, size_t index);
+
+inline void add(size_t counter, uint64_t value) {
+  ThreadCounters *counters = thread_counters;
+  if (!counters) {
+    counters = initializeThread();
+  }
+  size_t index = counter / kChunkSize;
+  Chunk *chunk = counters->chunks[index].load(boost::memory_order_acquire);
+  if (!chunk) {
+    chunk = allocateChunk(counters, index);
+  }
+  boost::atomic<uint64_t> &slot = chunk->values[counter % kChunkSize];
+  slot.store(
+      slot.load(boost::memory_order_relaxed) + value,
+      boost::memory_order_relaxed);
+}
+
+// Current value of a monotonic clock in nanoseconds, used to time
+// compilations.
+uint64_t now();
+
+}  // namespace statistics
+
+}  // namespace generic_message
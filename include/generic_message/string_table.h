@@ -0,0 +1,97 @@
+/**
+ * Copyright (c) 2013, Lorenz Moesenlechner <moesenle@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The names of the contributors may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+namespace generic_message {
+
+// Interned strings, identified by dense 32 bit ids. Every distinct string
+// is stored once. Characters and entries are never moved once they have
+// been added, so str and length may be called without synchronization on
+// ids that were obtained before. intern must not run concurrently with
+// any other call that takes a string.
+class StringTable : private boost::noncopyable {
+ public:
+  static const uint32_t kNotFound = 0xffffffff;
+
+  StringTable();
+  ~StringTable();
+
+  uint32_t intern(const std::string &value);
+  // Id of value, or kNotFound if it has not been interned.
+  uint32_t find(const std::string &value) const;
+  const char *str(uint32_t id) const { return entry(id).data; }
+  uint32_t length(uint32_t id) const { return entry(id).length; }
+  bool equals(uint32_t id, const std::string &value) const;
+  size_t count() const { return count_; }
+  // Bytes allocated for characters, entries and the hash index.
+  size_t memoryUsage() const;
+
+ private:
+  struct Entry {
+    const char *data;
+    uint32_t length;
+    uint32_t hash;
+  };
+
+  // Segment i holds kFirstSegment << i entries, so that growing the table
+  // only ever allocates a new segment.
+  static const size_t kFirstSegment = 16;
+  static const size_t kSegments = 28;
+  static const size_t kBlockSize = 4096;
+
+  Entry *segments_[kSegments];
+  uint32_t count_;
+  std::vector<char *> blocks_;
+  size_t block_used_;
+  size_t character_bytes_;
+  // Open addressing hash index of ids. Empty slots hold kNotFound.
+  std::vector<uint32_t> index_;
+
+  const Entry &entry(uint32_t id) const {
+    uint32_t position = id / kFirstSegment + 1;
+    uint32_t segment = 31 - __builtin_clz(position);
+    return segments_[segment][id - kFirstSegment * ((1u << segment) - 1)];
+  }
+  Entry &entry(uint32_t id) {
+    return const_cast<Entry &>(
+        static_cast<const StringTable *>(this)->entry(id));
+  }
+  const char *store(const std::string &value);
+  void grow();
+};
+
+}  // namespace generic_message
@@ -0,0 +1,120 @@
+/**
+ * Copyright (c) 2013, Lorenz Moesenlechner <moesenle@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The names of the contributors may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <generic_message/compiled_message.h>
+
+namespace generic_message {
+
+class ConversionFailed : public std::runtime_error {
+ public:
+  ConversionFailed(const std::string &message)
+      : std::runtime_error(message) {}
+};
+
+// Converts serialized messages between little and big endian byte order.
+// The plan is compiled once per message: consecutive scalars of the same
+// width, including fixed size sub-messages and arrays, are merged into
+// runs that are swapped in bulk, using SIMD byte shuffles when the CPU
+// supports them. Only strings, length prefixed arrays and arrays of
+// dynamic messages need to be walked element by element.
+class SwapPlan {
+ public:
+  typedef enum {
+    // The data is in the opposite byte order of the host, e.g. logs of a
+    // big endian controller read on x86, and is converted to host order.
+    TO_NATIVE,
+    // The data is in host order and is converted to the opposite order.
+    FROM_NATIVE
+  } direction_type;
+
+  explicit SwapPlan(const CompiledMessage &message);
+
+  // Converts the message at data in place and returns its size. Throws
+  // ConversionFailed if the message does not fit into size bytes, in
+  // which case data is partially converted.
+  size_t apply(void *data, size_t size, direction_type direction) const;
+  // Writes the converted message at input to output, which must have room
+  // for size bytes, and returns the message's size.
+  size_t apply(
+      const void *input, void *output, size_t size,
+      direction_type direction) const;
+
+  // Number of operations of the plan, including those of sub-plans for
+  // arrays of messages.
+  size_t operationCount() const;
+
+ private:
+  struct Operation {
+    typedef enum {
+      // count scalars of width bytes.
+      RUN,
+      // A length prefixed string.
+      STRING,
+      // A length prefixed array with count scalars of width bytes per
+      // element.
+      PREFIXED_RUN,
+      // count strings, or a length prefixed array of strings if count is
+      // kUnbounded.
+      STRINGS,
+      // Like STRINGS with elements described by plan.
+      MESSAGES
+    } operation_kind;
+
+    uint8_t kind;
+    uint8_t width;
+    uint32_t count;
+    uint32_t plan;
+  };
+
+  typedef std::vector<Operation> Plan;
+
+  std::vector<Plan> plans_;
+  uint32_t root_;
+
+  uint32_t compile(
+      const CompiledMessage &message,
+      std::map<const CompiledMessage *, uint32_t> *plan_indices);
+  static void appendRun(Plan *plan, uint8_t width, uint64_t count);
+  static void append(Plan *plan, const Operation &operation);
+  size_t operationCount(uint32_t plan) const;
+  size_t run(
+      uint32_t plan, const uint8_t *input, uint8_t *output, size_t size,
+      bool to_native) const;
+};
+
+}  // namespace generic_message
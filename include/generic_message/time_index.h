@@ -0,0 +1,135 @@
+/**
+ * Copyright (c) 2013, Lorenz Moesenlechner <moesenle@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The names of the contributors may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+
+#include <generic_message/compiled_message.h>
+#include <generic_message/field_path.h>
+
+namespace generic_message {
+
+class TimeIndexError : public std::runtime_error {
+ public:
+  TimeIndexError(const std::string &message)
+      : std::runtime_error(message) {}
+};
+
+class MappedFile;
+
+// Collects the time stamps of a recorded stream of one message type and
+// writes them as a time index file. Streams are sequences of messages,
+// each preceded by its size as a uint32. Time stamps are read from a
+// time field such as header.stamp and stored as nanoseconds.
+class TimeIndexBuilder {
+ public:
+  // Throws TimeIndexError if time_path does not address a time field.
+  TimeIndexBuilder(const CompiledMessage &message, const std::string &time_path);
+
+  size_t size() const { return entries_.size(); }
+
+  // Adds the message of size bytes whose length prefix is at offset in
+  // the stream. Throws InvalidMessage if the message does not fit.
+  void add(const void *data, size_t size, uint64_t offset);
+  // Adds all messages of a stream, or of a part of a stream that starts
+  // at offset.
+  void addStream(const void *data, size_t size, uint64_t offset = 0);
+  void addStreamFile(const std::string &stream_file);
+  void write(const std::string &index_file) const;
+
+ private:
+  const CompiledMessage *message_;
+  const FieldPath *path_;
+  // Time stamps and offsets in the order they were added.
+  std::vector<std::pair<uint64_t, uint64_t> > entries_;
+  // End of the last message that was added.
+  uint64_t stream_size_;
+};
+
+// A time index opened together with its stream; both are memory mapped.
+// The index sorts messages by time stamp and stores them in blocks of
+// kBlockSize entries. Each block starts with an absolute time stamp and
+// offset, followed by variable length deltas to the previous entry. A
+// query binary searches the block table and decodes blocks sequentially
+// from there, so a short time window of a large recording touches a few
+// pages of the index.
+class TimeIndex : private boost::noncopyable {
+ public:
+  static const uint32_t kBlockSize = 128;
+
+  struct Entry {
+    // Nanoseconds since the epoch of the message's time field.
+    uint64_t stamp;
+    // Offset of the message's length prefix in the stream.
+    uint64_t offset;
+  };
+
+  // Throws TimeIndexError if the index does not belong to the stream or
+  // was built for a different message type.
+  TimeIndex(
+      const CompiledMessage &message, const std::string &stream_file,
+      const std::string &index_file);
+  ~TimeIndex();
+
+  static uint64_t toNanoseconds(uint32_t sec, uint32_t nsec) {
+    return sec * 1000000000ull + nsec;
+  }
+
+  size_t size() const { return entry_count_; }
+  // Stores the entries with begin <= stamp < end in entries, ordered by
+  // time stamp and offset.
+  void query(uint64_t begin, uint64_t end, std::vector<Entry> *entries) const;
+  // The message of an entry in the mapped stream.
+  const void *message(const Entry &entry, size_t *size) const;
+
+ private:
+  friend class TimeIndexBuilder;
+
+  struct Block;
+
+  boost::scoped_ptr<MappedFile> stream_;
+  boost::scoped_ptr<MappedFile> index_;
+  uint64_t entry_count_;
+  uint64_t block_count_;
+  const Block *blocks_;
+  // Delta encoded entries of all blocks.
+  const uint8_t *deltas_;
+  const uint8_t *deltas_end_;
+};
+
+}  // namespace generic_message
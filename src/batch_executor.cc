@@ -0,0 +1,337 @@
+/**
+ * Copyright (c) 2013, Lorenz Moesenlechner <moesenle@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The names of the contributors may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <generic_message/batch_executor.h>
+
+#include <string.h>
+
+#include <algorithm>
+
+#include <boost/thread/locks.hpp>
+
+#include <generic_message/field_path.h>
+
+namespace generic_message {
+
+const size_t BatchScratch::kBlockSize;
+
+namespace {
+
+// Number of buffers a worker takes from its share at once. Small enough to
+// keep the shares stealable, large enough to keep the locks cold.
+const size_t kChunkSize = 16;
+
+const size_t kAlignment = 16;
+
+struct ExtractedField {
+  const FieldPath *path;
+  BaseType::base_type type;
+};
+
+template<typename T>
+double read(const uint8_t *data) {
+  T value;
+  memcpy(&value, data, sizeof(T));
+  return value;
+}
+
+double readNumber(BaseType::base_type type, const uint8_t *data) {
+  switch (type) {
+    case BaseType::BOOL:
+    case BaseType::UINT8: return read<uint8_t>(data);
+    case BaseType::INT8: return read<int8_t>(data);
+    case BaseType::INT16: return read<int16_t>(data);
+    case BaseType::UINT16: return read<uint16_t>(data);
+    case BaseType::INT32: return read<int32_t>(data);
+    case BaseType::UINT32: return read<uint32_t>(data);
+    case BaseType::INT64: return read<int64_t>(data);
+    case BaseType::UINT64: return read<uint64_t>(data);
+    case BaseType::FLOAT32: return read<float>(data);
+    case BaseType::FLOAT64: return read<double>(data);
+    case BaseType::TIME:
+      return read<uint32_t>(data) + read<uint32_t>(data + 4) * 1e-9;
+    case BaseType::DURATION:
+      return read<int32_t>(data) + read<int32_t>(data + 4) * 1e-9;
+    default:
+      return 0.0;
+  }
+}
+
+void extractFields(
+    const std::vector<ExtractedField> *fields, std::vector<double> *values,
+    size_t index, const MessageView &view, BatchScratch *) {
+  const uint8_t *data = reinterpret_cast<const uint8_t *>(view.data());
+  double *row = &(*values)[index * fields->size()];
+  for (size_t i = 0; i < fields->size(); i++) {
+    const ExtractedField &field = (*fields)[i];
+    row[i] = readNumber(field.type, data + field.path->offset(data));
+  }
+}
+
+std::vector<const void *> bufferPointers(
+    const std::vector<std::vector<uint8_t> > &buffers) {
+  std::vector<const void *> pointers(buffers.size());
+  for (size_t i = 0; i < buffers.size(); i++) {
+    pointers[i] = buffers[i].empty() ? 0 : &buffers[i][0];
+  }
+  return pointers;
+}
+
+}  // namespace
+
+// A worker's share of the current batch. The owner takes chunks from the
+// front, thieves take the back half.
+struct BatchExecutor::Worker {
+  boost::mutex mutex;
+  size_t begin;
+  size_t end;
+  BatchScratch scratch;
+
+  Worker(size_t index) : begin(0), end(0), scratch(index) {}
+};
+
+BatchScratch::BatchScratch(size_t worker)
+    : worker_(worker), block_(0), used_(0) {}
+
+void *BatchScratch::allocate(size_t size) {
+  size = (size + kAlignment - 1) & ~(kAlignment - 1);
+  while (block_ < blocks_.size() && used_ + size > blocks_[block_].size()) {
+    block_++;
+    used_ = 0;
+  }
+  if (block_ == blocks_.size()) {
+    blocks_.push_back(std::vector<uint8_t>(std::max(size, kBlockSize)));
+    used_ = 0;
+  }
+  void *result = &blocks_[block_][used_];
+  used_ += size;
+  return result;
+}
+
+void BatchScratch::reset(const CompiledMessage &message, const void *data) {
+  if (view_) {
+    view_->reset(message, data);
+  } else {
+    view_ = MessageView(message, data);
+  }
+  block_ = 0;
+  used_ = 0;
+}
+
+BatchExecutor::BatchExecutor(size_t threads)
+    : generation_(0), running_(0), stopping_(false), message_(0),
+      buffers_(0), callback_(0), failed_(false), failed_index_(0) {
+  if (threads == 0) {
+    threads = std::max(1u, boost::thread::hardware_concurrency());
+  }
+  for (size_t i = 0; i < threads; i++) {
+    workers_.push_back(new Worker(i));
+  }
+  for (size_t i = 1; i < threads; i++) {
+    threads_.push_back(new boost::thread(
+        boost::bind(&BatchExecutor::threadMain, this, i)));
+  }
+}
+
+BatchExecutor::~BatchExecutor() {
+  {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  start_.notify_all();
+  for (size_t i = 0; i < threads_.size(); i++) {
+    threads_[i]->join();
+    delete threads_[i];
+  }
+  for (size_t i = 0; i < workers_.size(); i++) {
+    delete workers_[i];
+  }
+}
+
+void BatchExecutor::forEach(
+    const CompiledMessage &message, const std::vector<const void *> &buffers,
+    const callback_type &callback) {
+  if (buffers.empty()) {
+    return;
+  }
+  boost::lock_guard<boost::mutex> batch_lock(batch_mutex_);
+  message_ = &message;
+  buffers_ = &buffers;
+  callback_ = &callback;
+  failed_ = false;
+  size_t count = buffers.size();
+  for (size_t i = 0; i < workers_.size(); i++) {
+    Worker &worker = *workers_[i];
+    boost::lock_guard<boost::mutex> lock(worker.mutex);
+    worker.begin = count * i / workers_.size();
+    worker.end = count * (i + 1) / workers_.size();
+  }
+  {
+    boost::lock_guard<boost::mutex> lock(mutex_);
+    running_ = threads_.size();
+    generation_++;
+  }
+  start_.notify_all();
+  work(0);
+  {
+    boost::unique_lock<boost::mutex> lock(mutex_);
+    while (running_ > 0) {
+      done_.wait(lock);
+    }
+  }
+  if (failed_) {
+    throw BatchFailed(failed_index_, failure_);
+  }
+}
+
+void BatchExecutor::forEach(
+    const CompiledMessage &message,
+    const std::vector<std::vector<uint8_t> > &buffers,
+    const callback_type &callback) {
+  forEach(message, bufferPointers(buffers), callback);
+}
+
+void BatchExecutor::extract(
+    const CompiledMessage &message, const std::vector<const void *> &buffers,
+    const std::vector<std::string> &paths, std::vector<double> *values) {
+  std::vector<ExtractedField> fields(paths.size());
+  for (size_t i = 0; i < paths.size(); i++) {
+    fields[i].path = &message.fieldPath(paths[i]);
+    const BaseType *type = boost::get<BaseType>(&fields[i].path->type());
+    if (!type || type->type == BaseType::STRING ||
+        type->type == BaseType::UNKNOWN) {
+      throw InvalidExtraction("Not a numeric field: " + paths[i]);
+    }
+    fields[i].type = type->type;
+  }
+  values->resize(buffers.size() * fields.size());
+  if (fields.empty()) {
+    return;
+  }
+  forEach(message, buffers, boost::bind(
+      &extractFields, &fields, values, boost::placeholders::_1,
+      boost::placeholders::_2, boost::placeholders::_3));
+}
+
+void BatchExecutor::extract(
+    const CompiledMessage &message,
+    const std::vector<std::vector<uint8_t> > &buffers,
+    const std::vector<std::string> &paths, std::vector<double> *values) {
+  extract(message, bufferPointers(buffers), paths, values);
+}
+
+void BatchExecutor::threadMain(size_t worker) {
+  size_t generation = 0;
+  while (true) {
+    {
+      boost::unique_lock<boost::mutex> lock(mutex_);
+      while (generation_ == generation && !stopping_) {
+        start_.wait(lock);
+      }
+      if (stopping_) {
+        return;
+      }
+      generation = generation_;
+    }
+    work(worker);
+    {
+      boost::lock_guard<boost::mutex> lock(mutex_);
+      if (--running_ == 0) {
+        done_.notify_all();
+      }
+    }
+  }
+}
+
+void BatchExecutor::work(size_t worker) {
+  BatchScratch &scratch = workers_[worker]->scratch;
+  size_t begin, end;
+  // A successful steal only refills the worker's own share, the chunk
+  // is then taken from there.
+  while (!failed_ &&
+         (take(worker, &begin, &end) ||
+          (steal(worker) && take(worker, &begin, &end)))) {
+    for (size_t i = begin; i < end && !failed_; i++) {
+      try {
+        scratch.reset(*message_, (*buffers_)[i]);
+        (*callback_)(i, *scratch.view_, &scratch);
+      } catch (const std::exception &e) {
+        fail(i, e.what());
+      } catch (...) {
+        // Anything escaping a worker thread would terminate the process.
+        fail(i, "Unknown exception");
+      }
+    }
+  }
+}
+
+void BatchExecutor::fail(size_t index, const std::string &failure) {
+  boost::lock_guard<boost::mutex> lock(mutex_);
+  if (!failed_) {
+    failed_index_ = index;
+    failure_ = failure;
+    failed_ = true;
+  }
+}
+
+bool BatchExecutor::take(size_t worker, size_t *begin, size_t *end) {
+  Worker &share = *workers_[worker];
+  boost::lock_guard<boost::mutex> lock(share.mutex);
+  if (share.begin == share.end) {
+    return false;
+  }
+  *begin = share.begin;
+  *end = std::min(share.end, share.begin + kChunkSize);
+  share.begin = *end;
+  return true;
+}
+
+bool BatchExecutor::steal(size_t worker) {
+  for (size_t i = 1; i < workers_.size(); i++) {
+    Worker &victim = *workers_[(worker + i) % workers_.size()];
+    size_t begin, end;
+    {
+      boost::lock_guard<boost::mutex> lock(victim.mutex);
+      if (victim.begin == victim.end) {
+        continue;
+      }
+      begin = victim.begin + (victim.end - victim.begin) / 2;
+      end = victim.end;
+      victim.end = begin;
+    }
+    Worker &thief = *workers_[worker];
+    boost::lock_guard<boost::mutex> lock(thief.mutex);
+    thief.begin = begin;
+    thief.end = end;
+    return true;
+  }
+  return false;
+}
+
+}  // namespace generic_message
@@ -0,0 +1,808 @@
+/**
+ * Copyright (c) 2013, Lorenz Moesenlechner <moesenle@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The names of the contributors may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/bind/bind.hpp>
+#include <boost/foreach.hpp>
+#include <boost/function.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include <generic_message/batch_executor.h>
+#include <generic_message/compiled_message.h>
+#include <generic_message/delta_codec.h>
+#include <generic_message/field_gather.h>
+#include <generic_message/field_mutator.h>
+#include <generic_message/field_path.h>
+#include <generic_message/json_encoder.h>
+#include <generic_message/message_buffer.h>
+#include <generic_message/message_parser.h>
+#include <generic_message/message_pool.h>
+#include <generic_message/message_printer.h>
+#include <generic_message/message_traversal.h>
+#include <generic_message/message_view.h>
+#include <generic_message/shared_memory_ring.h>
+#include <generic_message/swap_plan.h>
+#include <generic_message/time_index.h>
+
+#include "sample_messages.h"
+
+using namespace generic_message;
+using namespace boost::placeholders;
+
+namespace {
+
+// Results of benchmarked calls are accumulated here so that the compiler
+// cannot drop them.
+volatile size_t sink;
+
+void runParse(const std::string *text, size_t iterations) {
+  for (size_t i = 0; i < iterations; i++) {
+    ParsedMessage message;
+    sink += parse_message(*text, &message);
+  }
+}
+
+void runPoolAdd(
+    MessagePool *pool, const Definition *definition, size_t iterations) {
+  for (size_t i = 0; i < iterations; i++) {
+    pool->add(definition->package, definition->name, definition->text);
+  }
+}
+
+void runCompile(
+    MessagePool *pool, const Definition *definition,
+    const ParsedMessage *message, size_t iterations) {
+  for (size_t i = 0; i < iterations; i++) {
+    // Messages are compiled on first use.
+    pool->add(definition->package, definition->name, *message);
+    sink += pool->get(definition->package, definition->name).isDynamic();
+  }
+}
+
+void runSize(
+    const CompiledMessage *message, const std::vector<uint8_t> *buffer,
+    size_t iterations) {
+  for (size_t i = 0; i < iterations; i++) {
+    sink += message->size(&(*buffer)[0]);
+  }
+}
+
+void runFieldOffsets(
+    const CompiledMessage *message, const std::vector<uint8_t> *buffer,
+    size_t iterations) {
+  const void *data = &(*buffer)[0];
+  size_t field_count = message->fields().size();
+  for (size_t i = 0; i < iterations; i++) {
+    for (size_t j = 0; j < field_count; j++) {
+      sink += message->offset(j, data);
+    }
+  }
+}
+
+void runMessageView(
+    const CompiledMessage *message, const std::vector<uint8_t> *buffer,
+    size_t iterations) {
+  const void *data = &(*buffer)[0];
+  size_t field_count = message->fields().size();
+  for (size_t i = 0; i < iterations; i++) {
+    // Reading the last field first and then the remaining ones in reverse
+    // is the worst case for CompiledMessage::offset and the best case for
+    // the view.
+    MessageView view(*message, data);
+    for (size_t j = field_count; j > 0; j--) {
+      sink += view.offset(j - 1);
+    }
+  }
+}
+
+void runFieldPath(
+    const FieldPath *path, const std::vector<uint8_t> *buffer,
+    size_t iterations) {
+  const void *data = &(*buffer)[0];
+  for (size_t i = 0; i < iterations; i++) {
+    sink += path->offset(data);
+  }
+}
+
+void runFieldPathLookup(
+    const CompiledMessage *message, const std::string *path,
+    const std::vector<uint8_t> *buffer, size_t iterations) {
+  const void *data = &(*buffer)[0];
+  for (size_t i = 0; i < iterations; i++) {
+    sink += message->fieldPath(*path).offset(data);
+  }
+}
+
+void runPrint(
+    MessagePrinter *printer, const CompiledMessage *message,
+    const std::vector<uint8_t> *buffer, size_t iterations) {
+  const void *data = &(*buffer)[0];
+  for (size_t i = 0; i < iterations; i++) {
+    sink += printer->print(*message, data).size();
+  }
+}
+
+// Sums all numbers and string lengths, touching every leaf.
+class SumVisitor : public TraversalVisitor {
+ public:
+  SumVisitor() : sum(0) {}
+
+  template<typename T>
+  void value(T value) { sum += value; }
+  void value(const StringValue &value) { sum += value.size; }
+  void value(const TimeValue &value) { sum += value.sec; }
+  void value(const DurationValue &value) { sum += value.sec; }
+
+  double sum;
+};
+
+// Only visits the dynamic parts of a message, jumping over fixed size
+// fields.
+class DynamicVisitor : public SumVisitor {
+ public:
+  bool beginField(const CompiledMessage &message, size_t field_index) {
+    return message.fields()[field_index].isDynamic();
+  }
+};
+
+template<typename Visitor>
+void runTraverse(
+    const CompiledMessage *message, const std::vector<uint8_t> *buffer,
+    size_t iterations) {
+  const void *data = &(*buffer)[0];
+  for (size_t i = 0; i < iterations; i++) {
+    Visitor visitor;
+    sink += traverse(*message, data, &visitor);
+    sink += visitor.sum != 0;
+  }
+}
+
+void runEncodeJson(
+    JsonEncoder *encoder, const CompiledMessage *message,
+    const std::string *json, std::vector<uint8_t> *output,
+    size_t iterations) {
+  for (size_t i = 0; i < iterations; i++) {
+    encoder->encode(*message, *json, output);
+    sink += output->size();
+  }
+}
+
+void runSwapCopy(
+    const SwapPlan *plan, const std::vector<uint8_t> *buffer,
+    std::vector<uint8_t> *output, size_t iterations) {
+  for (size_t i = 0; i < iterations; i++) {
+    sink += plan->apply(
+        &(*buffer)[0], &(*output)[0], buffer->size(), SwapPlan::FROM_NATIVE);
+  }
+}
+
+// Converts back and forth so that every iteration starts from host order.
+void runSwapInPlace(
+    const SwapPlan *plan, std::vector<uint8_t> *buffer, size_t iterations) {
+  for (size_t i = 0; i < iterations; i++) {
+    plan->apply(&(*buffer)[0], buffer->size(), SwapPlan::FROM_NATIVE);
+    sink += plan->apply(&(*buffer)[0], buffer->size(), SwapPlan::TO_NATIVE);
+  }
+}
+
+size_t viewSize(const MessageView &view, BatchScratch *) {
+  return view.size();
+}
+
+void runBatchSize(
+    BatchExecutor *executor, const CompiledMessage *message,
+    const std::vector<const void *> *buffers, std::vector<size_t> *sizes,
+    size_t iterations) {
+  for (size_t i = 0; i < iterations; i++) {
+    executor->transform(*message, *buffers, &viewSize, sizes);
+    sink += (*sizes)[0];
+  }
+}
+
+void runDeltaEncode(
+    const DeltaCodec *codec, const std::vector<uint8_t> *reference,
+    const std::vector<uint8_t> *buffer, std::vector<uint8_t> *delta,
+    size_t iterations) {
+  for (size_t i = 0; i < iterations; i++) {
+    sink += codec->encode(&(*reference)[0], &(*buffer)[0], delta);
+  }
+}
+
+void runDeltaDecode(
+    const DeltaCodec *codec, const std::vector<uint8_t> *reference,
+    const std::vector<uint8_t> *delta, std::vector<uint8_t> *output,
+    size_t iterations) {
+  for (size_t i = 0; i < iterations; i++) {
+    sink += codec->decode(
+        &(*reference)[0], &(*delta)[0], delta->size(), output);
+  }
+}
+
+// Rewrites the header like a relay does, alternating between frame ids of
+// different lengths so that every iteration moves the rest of the message.
+void runMutateHeader(
+    const FieldMutator *frame_id, const FieldMutator *stamp,
+    MessageBuffer *buffer, size_t iterations) {
+  static const std::string kFrameIds[] = {"base_link", "map_with_longer_name"};
+  for (size_t i = 0; i < iterations; i++) {
+    frame_id->setString(buffer, kFrameIds[i % 2]);
+    stamp->setTime(buffer->data(), i, 0);
+    sink += buffer->size();
+  }
+}
+
+void runRing(
+    RingWriter *writer, RingReader *reader,
+    const std::vector<uint8_t> *buffer, size_t iterations) {
+  RingMessage message;
+  for (size_t i = 0; i < iterations; i++) {
+    writer->write(&(*buffer)[0], buffer->size());
+    if (reader->read(&message) && reader->isCurrent(message)) {
+      sink += message.size;
+    }
+  }
+}
+
+void runGather(
+    const FieldGather *gather, const std::vector<const void *> *buffers,
+    std::vector<uint8_t> *output, size_t iterations) {
+  for (size_t i = 0; i < iterations; i++) {
+    gather->gather(&(*buffers)[0], buffers->size(), &(*output)[0]);
+    sink += (*output)[0];
+  }
+}
+
+// Time of the first message of the streams of the time index benchmarks.
+const uint32_t kStreamStart = 1400000000;
+
+void runTimeIndexBuild(
+    const CompiledMessage *message, const std::vector<uint8_t> *stream,
+    size_t iterations) {
+  for (size_t i = 0; i < iterations; i++) {
+    TimeIndexBuilder builder(*message, "header.stamp");
+    builder.addStream(&(*stream)[0], stream->size());
+    sink += builder.size();
+  }
+}
+
+void runTimeIndexQuery(
+    const TimeIndex *index, uint64_t begin, uint64_t end,
+    std::vector<TimeIndex::Entry> *entries, size_t iterations) {
+  for (size_t i = 0; i < iterations; i++) {
+    index->query(begin, end, entries);
+    sink += entries->size();
+  }
+}
+
+// Appends count copies of buffer to a stream with length prefixes, with
+// time stamps 10 ms apart like a 100 Hz sensor.
+void makeStream(
+    const FieldMutator &stamp, const std::vector<uint8_t> &buffer,
+    size_t count, std::vector<uint8_t> *stream) {
+  std::vector<uint8_t> message(buffer);
+  uint32_t length = message.size();
+  for (size_t i = 0; i < count; i++) {
+    stamp.setTime(&message[0], kStreamStart + i / 100, i % 100 * 10000000);
+    const uint8_t *prefix = reinterpret_cast<const uint8_t *>(&length);
+    stream->insert(stream->end(), prefix, prefix + 4);
+    stream->insert(stream->end(), message.begin(), message.end());
+  }
+}
+
+std::string writeTemporaryFile(const std::vector<uint8_t> &data) {
+  char name[] = "/tmp/benchmark_generic_message.XXXXXX";
+  int fd = mkstemp(name);
+  if (fd < 0 ||
+      write(fd, data.empty() ? 0 : &data[0], data.size()) !=
+          static_cast<ssize_t>(data.size())) {
+    std::cerr << "Unable to write " << name << std::endl;
+    exit(1);
+  }
+  close(fd);
+  return name;
+}
+
+// Upper bounds for the number and total size of the buffers a field is
+// gathered from or that are written to a stream.
+const size_t kGatherBuffers = 100000;
+const size_t kGatherBytes = 64 << 20;
+
+// Number of buffers per batch in the batch benchmarks.
+const size_t kBatchSize = 256;
+
+struct Benchmark {
+  std::string name;
+  // Bytes processed per iteration, used for throughput. Zero if
+  // throughput is not meaningful for this benchmark.
+  size_t bytes_per_op;
+  boost::function<void (size_t)> run;
+
+  Benchmark(
+      const std::string &name, size_t bytes_per_op,
+      const boost::function<void (size_t)> &run)
+      : name(name), bytes_per_op(bytes_per_op), run(run) {}
+};
+
+struct Result {
+  std::string name;
+  size_t iterations;
+  double ns_per_op;
+  double bytes_per_second;
+};
+
+double now() {
+  timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return time.tv_sec + time.tv_nsec * 1e-9;
+}
+
+Result measure(const Benchmark &benchmark, double min_time) {
+  size_t iterations = 1;
+  double elapsed = 0;
+  while (true) {
+    double start = now();
+    benchmark.run(iterations);
+    elapsed = now() - start;
+    if (elapsed >= min_time || iterations >= (size_t(1) << 40)) {
+      break;
+    }
+    // Aim slightly above the minimum time to avoid another round.
+    double scale = elapsed > 0 ? 1.4 * min_time / elapsed : 100;
+    if (scale > 100) {
+      scale = 100;
+    } else if (scale < 2) {
+      scale = 2;
+    }
+    iterations = static_cast<size_t>(iterations * scale);
+  }
+  Result result;
+  result.name = benchmark.name;
+  result.iterations = iterations;
+  result.ns_per_op = elapsed * 1e9 / iterations;
+  result.bytes_per_second = benchmark.bytes_per_op
+      ? benchmark.bytes_per_op * iterations / elapsed
+      : 0;
+  return result;
+}
+
+std::string jsonEscape(const std::string &value) {
+  std::string result;
+  BOOST_FOREACH(char c, value) {
+    if (c == '"' || c == '\\') {
+      result += '\\';
+    }
+    result += c;
+  }
+  return result;
+}
+
+void printHeader(const std::string &format) {
+  if (format == "csv") {
+    std::cout << "name,iterations,ns_per_op,bytes_per_second" << std::endl;
+  } else if (format == "json") {
+    std::cout << "[" << std::endl;
+  } else {
+    std::cout << std::left << std::setw(48) << "benchmark"
+              << std::right << std::setw(14) << "iterations"
+              << std::setw(14) << "ns/op"
+              << std::setw(14) << "MB/s" << std::endl;
+  }
+}
+
+void printResult(const std::string &format, const Result &result, bool first) {
+  if (format == "csv") {
+    std::cout << result.name << "," << result.iterations << ","
+              << std::fixed << std::setprecision(3) << result.ns_per_op << ","
+              << std::setprecision(0) << result.bytes_per_second << std::endl;
+  } else if (format == "json") {
+    std::cout << (first ? "  " : ", ")
+              << "{\"name\": \"" << jsonEscape(result.name) << "\""
+              << ", \"iterations\": " << result.iterations
+              << std::fixed << std::setprecision(3)
+              << ", \"ns_per_op\": " << result.ns_per_op
+              << std::setprecision(0)
+              << ", \"bytes_per_second\": " << result.bytes_per_second
+              << "}" << std::endl;
+  } else {
+    std::cout << std::left << std::setw(48) << result.name
+              << std::right << std::setw(14) << result.iterations
+              << std::setw(14) << std::fixed << std::setprecision(1)
+              << result.ns_per_op << std::setw(14);
+    if (result.bytes_per_second > 0) {
+      std::cout << std::setprecision(1) << result.bytes_per_second / 1e6;
+    } else {
+      std::cout << "-";
+    }
+    std::cout << std::endl;
+  }
+}
+
+void printFooter(const std::string &format) {
+  if (format == "json") {
+    std::cout << "]" << std::endl;
+  }
+}
+
+void printMemoryUsage(
+    const std::string &format, const MessagePool::MemoryUsage &usage) {
+  const std::pair<const char *, size_t> values[] = {
+    std::make_pair("strings", usage.strings),
+    std::make_pair("string_bytes", usage.string_bytes),
+    std::make_pair("definitions", usage.definitions),
+    std::make_pair("definition_bytes", usage.definition_bytes),
+    std::make_pair("compiled_messages", usage.compiled_messages),
+    std::make_pair("compiled_fields", usage.compiled_fields),
+    std::make_pair("compiled_bytes", usage.compiled_bytes),
+    std::make_pair("total_bytes", usage.total()),
+  };
+  const size_t count = sizeof(values) / sizeof(values[0]);
+  if (format == "csv") {
+    std::cout << "name,value" << std::endl;
+  } else if (format == "json") {
+    std::cout << "{" << std::endl;
+  }
+  for (size_t i = 0; i < count; i++) {
+    if (format == "csv") {
+      std::cout << values[i].first << "," << values[i].second << std::endl;
+    } else if (format == "json") {
+      std::cout << (i == 0 ? "  " : ", ") << "\"" << values[i].first
+                << "\": " << values[i].second << std::endl;
+    } else {
+      std::cout << std::left << std::setw(48) << values[i].first
+                << std::right << std::setw(14) << values[i].second
+                << std::endl;
+    }
+  }
+  if (format == "json") {
+    std::cout << "}" << std::endl;
+  }
+}
+
+// Whether the filter selects any benchmark of a group for a sample.
+// Groups that are not selected are not set up, since some of them copy
+// buffers into tens of megabytes of memory or temporary files. Names may
+// continue after the label, e.g. with the number of buffers.
+bool selected(
+    const std::string &filter, const std::string &group, const char *label) {
+  std::string name = group + "/" + label + "/";
+  return name.find(filter) != std::string::npos ||
+      filter.compare(0, name.size(), name) == 0;
+}
+
+int usage(const char *program) {
+  std::cerr << "Usage: " << program
+            << " [--format=table|csv|json] [--filter=<substring>]"
+            << " [--min-time=<seconds>] [--memory]" << std::endl;
+  return 1;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[]) {
+  std::string format = "table";
+  std::string filter;
+  double min_time = 0.2;
+  bool memory = false;
+  for (int i = 1; i < argc; i++) {
+    std::string argument = argv[i];
+    if (argument.compare(0, 9, "--format=") == 0) {
+      format = argument.substr(9);
+    } else if (argument.compare(0, 9, "--filter=") == 0) {
+      filter = argument.substr(9);
+    } else if (argument.compare(0, 11, "--min-time=") == 0) {
+      min_time = atof(argument.substr(11).c_str());
+    } else if (argument == "--memory") {
+      memory = true;
+    } else {
+      return usage(argv[0]);
+    }
+  }
+  if (format != "table" && format != "csv" && format != "json") {
+    return usage(argv[0]);
+  }
+
+  MessagePool pool;
+  addDefinitions(&pool);
+  // A second pool that is only used for the add benchmarks, since those
+  // replace the compiled messages that the access benchmarks point to.
+  MessagePool add_pool;
+  addDefinitions(&add_pool);
+
+  std::vector<std::string> texts(kSampleCount);
+  std::vector<ParsedMessage> parsed(kSampleCount);
+  std::vector<std::vector<uint8_t> > buffers(kSampleCount);
+  std::vector<std::string> field_paths(kSampleCount);
+  std::vector<MessagePrinter> yaml_printers(
+      kSampleCount, MessagePrinter(MessagePrinter::YAML));
+  std::vector<MessagePrinter> json_printers(
+      kSampleCount, MessagePrinter(MessagePrinter::JSON));
+  std::vector<JsonEncoder> json_encoders(kSampleCount);
+  std::vector<std::string> json_texts(kSampleCount);
+  std::vector<std::vector<uint8_t> > encoded(kSampleCount);
+  std::vector<boost::shared_ptr<SwapPlan> > swap_plans(kSampleCount);
+  BatchExecutor executor;
+  std::vector<boost::shared_ptr<DeltaCodec> > delta_codecs(kSampleCount);
+  std::vector<boost::shared_ptr<FieldMutator> > frame_ids(kSampleCount);
+  std::vector<boost::shared_ptr<FieldMutator> > stamps(kSampleCount);
+  std::vector<MessageBuffer> mutated(kSampleCount);
+  std::vector<boost::shared_ptr<RingWriter> > ring_writers(kSampleCount);
+  std::vector<boost::shared_ptr<RingReader> > ring_readers(kSampleCount);
+  std::vector<boost::shared_ptr<FieldGather> > gathers(kSampleCount);
+  std::vector<std::vector<uint8_t> > gather_copies(kSampleCount);
+  std::vector<std::vector<const void *> > gather_buffers(kSampleCount);
+  std::vector<std::vector<uint8_t> > gathered(kSampleCount);
+  std::vector<std::vector<uint8_t> > streams(kSampleCount);
+  std::vector<boost::shared_ptr<TimeIndex> > time_indices(kSampleCount);
+  std::vector<std::vector<TimeIndex::Entry> > time_entries(kSampleCount);
+  std::vector<std::vector<uint8_t> > changed(kSampleCount);
+  std::vector<std::vector<uint8_t> > deltas(kSampleCount);
+  std::vector<std::vector<uint8_t> > decoded(kSampleCount);
+  std::vector<std::vector<const void *> > batches(kSampleCount);
+  std::vector<std::vector<size_t> > batch_sizes(kSampleCount);
+  std::vector<std::vector<uint8_t> > swapped(kSampleCount);
+  std::vector<std::vector<uint8_t> > swap_buffers(kSampleCount);
+  std::vector<Benchmark> benchmarks;
+
+  for (size_t i = 0; i < kSampleCount; i++) {
+    const Sample &sample = kSamples[i];
+    const Definition &definition = findDefinition(sample.package, sample.name);
+    texts[i] = definition.text;
+    if (!parse_message(texts[i], &parsed[i])) {
+      std::cerr << "Unable to parse " << sample.package << "/"
+                << sample.name << std::endl;
+      return 1;
+    }
+    benchmarks.push_back(Benchmark(
+        std::string("parse/") + sample.label, texts[i].size(),
+        boost::bind(&runParse, &texts[i], _1)));
+  }
+
+  for (size_t i = 0; i < kSampleCount; i++) {
+    const Sample &sample = kSamples[i];
+    const Definition &definition = findDefinition(sample.package, sample.name);
+    benchmarks.push_back(Benchmark(
+        std::string("pool_add/") + sample.label, texts[i].size(),
+        boost::bind(&runPoolAdd, &add_pool, &definition, _1)));
+    benchmarks.push_back(Benchmark(
+        std::string("compile/") + sample.label, 0,
+        boost::bind(&runCompile, &add_pool, &definition, &parsed[i], _1)));
+  }
+
+  for (size_t i = 0; i < kSampleCount; i++) {
+    const Sample &sample = kSamples[i];
+    const CompiledMessage &message = pool.get(sample.package, sample.name);
+    generateBuffer(pool, sample, &buffers[i]);
+    benchmarks.push_back(Benchmark(
+        std::string("size/") + sample.label, buffers[i].size(),
+        boost::bind(&runSize, &message, &buffers[i], _1)));
+    std::ostringstream name;
+    name << "field_offsets/" << sample.label << "/" << message.fields().size();
+    benchmarks.push_back(Benchmark(
+        name.str(), 0,
+        boost::bind(&runFieldOffsets, &message, &buffers[i], _1)));
+    benchmarks.push_back(Benchmark(
+        std::string("message_view/") + sample.label, 0,
+        boost::bind(&runMessageView, &message, &buffers[i], _1)));
+    field_paths[i] = sample.path;
+    benchmarks.push_back(Benchmark(
+        std::string("field_path/") + sample.label, 0,
+        boost::bind(
+            &runFieldPath, &message.fieldPath(field_paths[i]), &buffers[i], _1)));
+    benchmarks.push_back(Benchmark(
+        std::string("field_path_lookup/") + sample.label, 0,
+        boost::bind(
+            &runFieldPathLookup, &message, &field_paths[i], &buffers[i], _1)));
+    benchmarks.push_back(Benchmark(
+        std::string("print_yaml/") + sample.label, buffers[i].size(),
+        boost::bind(
+            &runPrint, &yaml_printers[i], &message, &buffers[i], _1)));
+    benchmarks.push_back(Benchmark(
+        std::string("print_json/") + sample.label, buffers[i].size(),
+        boost::bind(
+            &runPrint, &json_printers[i], &message, &buffers[i], _1)));
+    benchmarks.push_back(Benchmark(
+        std::string("traverse/") + sample.label, buffers[i].size(),
+        boost::bind(&runTraverse<SumVisitor>, &message, &buffers[i], _1)));
+    benchmarks.push_back(Benchmark(
+        std::string("traverse_dynamic/") + sample.label, buffers[i].size(),
+        boost::bind(&runTraverse<DynamicVisitor>, &message, &buffers[i], _1)));
+    batches[i].assign(kBatchSize, &buffers[i][0]);
+    std::ostringstream batch_name;
+    batch_name << "batch_size/" << sample.label << "/" << executor.threadCount();
+    benchmarks.push_back(Benchmark(
+        batch_name.str(), kBatchSize * buffers[i].size(),
+        boost::bind(
+            &runBatchSize, &executor, &message, &batches[i], &batch_sizes[i],
+            _1)));
+    if (selected(filter, "encode_json", sample.label)) {
+      json_texts[i] = json_printers[i].print(message, &buffers[i][0]);
+      benchmarks.push_back(Benchmark(
+          std::string("encode_json/") + sample.label, json_texts[i].size(),
+          boost::bind(
+              &runEncodeJson, &json_encoders[i], &message, &json_texts[i],
+              &encoded[i], _1)));
+    }
+    if (selected(filter, "swap_copy", sample.label) ||
+        selected(filter, "swap_in_place", sample.label)) {
+      swap_plans[i] = boost::make_shared<SwapPlan>(boost::cref(message));
+      swapped[i].resize(buffers[i].size());
+      swap_buffers[i] = buffers[i];
+      benchmarks.push_back(Benchmark(
+          std::string("swap_copy/") + sample.label, buffers[i].size(),
+          boost::bind(
+              &runSwapCopy, swap_plans[i].get(), &buffers[i], &swapped[i],
+              _1)));
+      benchmarks.push_back(Benchmark(
+          std::string("swap_in_place/") + sample.label, 2 * buffers[i].size(),
+          boost::bind(
+              &runSwapInPlace, swap_plans[i].get(), &swap_buffers[i], _1)));
+    }
+    if (selected(filter, "delta_encode", sample.label) ||
+        selected(filter, "delta_decode", sample.label)) {
+      // The next sample differs from the buffer in its last byte, which is
+      // part of the last field of every sample.
+      delta_codecs[i] = boost::make_shared<DeltaCodec>(boost::cref(message));
+      changed[i] = buffers[i];
+      changed[i].back() ^= 1;
+      delta_codecs[i]->encode(&buffers[i][0], &changed[i][0], &deltas[i]);
+      std::ostringstream delta_name;
+      delta_name << sample.label << "/" << deltas[i].size();
+      benchmarks.push_back(Benchmark(
+          "delta_encode/" + delta_name.str(), buffers[i].size(),
+          boost::bind(
+              &runDeltaEncode, delta_codecs[i].get(), &buffers[i],
+              &changed[i], &deltas[i], _1)));
+      benchmarks.push_back(Benchmark(
+          "delta_decode/" + delta_name.str(), buffers[i].size(),
+          boost::bind(
+              &runDeltaDecode, delta_codecs[i].get(), &buffers[i], &deltas[i],
+              &decoded[i], _1)));
+    }
+    size_t header_index;
+    bool has_header = message.findField("header", &header_index);
+    if (has_header && selected(filter, "mutate_header", sample.label)) {
+      frame_ids[i] = boost::make_shared<FieldMutator>(
+          boost::cref(message), std::string("header.frame_id"));
+      stamps[i] = boost::make_shared<FieldMutator>(
+          boost::cref(message), std::string("header.stamp"));
+      mutated[i].assign(&buffers[i][0], buffers[i].size());
+      benchmarks.push_back(Benchmark(
+          std::string("mutate_header/") + sample.label, buffers[i].size(),
+          boost::bind(
+              &runMutateHeader, frame_ids[i].get(), stamps[i].get(),
+              &mutated[i], _1)));
+    }
+    if (has_header &&
+        (selected(filter, "time_index_build", sample.label) ||
+         selected(filter, "time_index_query", sample.label))) {
+      FieldMutator stamp(message, "header.stamp");
+      size_t stream_count = std::max<size_t>(
+          1, std::min<size_t>(kGatherBuffers, kGatherBytes / buffers[i].size()));
+      makeStream(stamp, buffers[i], stream_count, &streams[i]);
+      std::ostringstream stream_name;
+      stream_name << sample.label << "/" << stream_count;
+      benchmarks.push_back(Benchmark(
+          "time_index_build/" + stream_name.str(), streams[i].size(),
+          boost::bind(&runTimeIndexBuild, &message, &streams[i], _1)));
+      // The files are unlinked right away, the index keeps them mapped.
+      std::string stream_file = writeTemporaryFile(streams[i]);
+      std::string index_file = writeTemporaryFile(std::vector<uint8_t>());
+      TimeIndexBuilder builder(message, "header.stamp");
+      builder.addStream(&streams[i][0], streams[i].size());
+      builder.write(index_file);
+      time_indices[i] = boost::make_shared<TimeIndex>(
+          boost::cref(message), stream_file, index_file);
+      unlink(stream_file.c_str());
+      unlink(index_file.c_str());
+      // A two second window in the middle of the stream.
+      uint64_t middle = TimeIndex::toNanoseconds(
+          kStreamStart + stream_count / 200, 0);
+      benchmarks.push_back(Benchmark(
+          "time_index_query/" + stream_name.str(), 0,
+          boost::bind(
+              &runTimeIndexQuery, time_indices[i].get(), middle,
+              middle + 2000000000ull, &time_entries[i], _1)));
+    }
+    if (selected(filter, "ring", sample.label)) {
+      // Rings live in anonymous memfds, the reader attaches through the
+      // file descriptor like a process that received it would.
+      ring_writers[i] = boost::make_shared<RingWriter>(
+          std::string(), boost::cref(message), 8, buffers[i].size());
+      ring_readers[i] = boost::make_shared<RingReader>(
+          ring_writers[i]->memory().fd(), boost::cref(message));
+      benchmarks.push_back(Benchmark(
+          std::string("ring/") + sample.label, buffers[i].size(),
+          boost::bind(
+              &runRing, ring_writers[i].get(), ring_readers[i].get(),
+              &buffers[i], _1)));
+    }
+    if (!selected(filter, "gather", sample.label)) {
+      continue;
+    }
+    // Gathers header.stamp, or the sample's path if there is no header,
+    // from copies of the buffer spread over up to 64 MB so that the
+    // fields are not all in cache.
+    std::string gather_path = has_header
+        ? std::string("header.stamp") : std::string(sample.path);
+    try {
+      gathers[i] = boost::make_shared<FieldGather>(
+          boost::cref(message), gather_path);
+    } catch (const GatherFailed &) {
+      continue;
+    }
+    size_t stride = (buffers[i].size() + 63) / 64 * 64;
+    size_t copies = std::max<size_t>(
+        1, std::min<size_t>(kGatherBuffers, kGatherBytes / stride));
+    gather_copies[i].resize(copies * stride);
+    for (size_t j = 0; j < copies; j++) {
+      std::copy(buffers[i].begin(), buffers[i].end(),
+                gather_copies[i].begin() + j * stride);
+      gather_buffers[i].push_back(&gather_copies[i][j * stride]);
+    }
+    gathered[i].resize(copies * gathers[i]->size());
+    std::ostringstream gather_name;
+    gather_name << "gather/" << sample.label << "/" << copies;
+    benchmarks.push_back(Benchmark(
+        gather_name.str(), copies * gathers[i]->size(),
+        boost::bind(
+            &runGather, gathers[i].get(), &gather_buffers[i], &gathered[i],
+            _1)));
+  }
+
+  // Reports the memory used by the compiled samples and their field paths
+  // instead of running the benchmarks.
+  if (memory) {
+    printMemoryUsage(format, pool.memoryUsage());
+    return 0;
+  }
+
+  printHeader(format);
+  bool first = true;
+  BOOST_FOREACH(const Benchmark &benchmark, benchmarks) {
+    if (benchmark.name.find(filter) == std::string::npos) {
+      continue;
+    }
+    printResult(format, measure(benchmark, min_time), first);
+    first = false;
+  }
+  printFooter(format);
+  return 0;
+}
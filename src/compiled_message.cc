@@ -30,198 +30,364 @@
 #include <generic_message/compiled_message.h>
 
 #include <stdint.h>
+#include <string.h>
+
+#include <map>
 
 #include <boost/foreach.hpp>
-#include <boost/lexical_cast.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
 
+#include <generic_message/field_path.h>
 #include <generic_message/message_pool.h>
 #include <generic_message/message_type_traits.h>
+#include <generic_message/statistics.h>
 
 namespace generic_message {
 
-static size_t zero_offset(const void *) {
-  return 0;
-}
-
-static size_t sizeOf(const BaseType &type) {
-  using boost::lexical_cast;
-
-  switch (type.type) {
-    case BaseType::BOOL:
-    case BaseType::INT8:
-    case BaseType::UINT8: return 1;
-    case BaseType::INT16:
-    case BaseType::UINT16: return 2;
-    case BaseType::INT32:
-    case BaseType::UINT32:
-    case BaseType::FLOAT32: return 4;
-    case BaseType::INT64:
-    case BaseType::UINT64:
-    case BaseType::FLOAT64: return 8;
-    case BaseType::TIME:
-    case BaseType::DURATION: return 8;
-    default:
-      throw CompilationFailed(
-          "Not a fixed size type type: " + lexical_cast<std::string>(type.type));
-  }
+const uint32_t CompiledMessage::CompiledField::kUnbounded;
+
+static uint32_t readLength(const uint8_t *data) {
+  // Length prefixes are not necessarily aligned.
+  uint32_t length;
+  memcpy(&length, data, sizeof(length));
+  return length;
 }
 
-static size_t sizeOf(
-    const MessagePool &pool, const BaseType &type, const void *data) {
-  if (type.type == BaseType::STRING) {
-    return *reinterpret_cast<const uint32_t *>(data) + 4;
-  } else {
-    return sizeOf(type);
+static void checkAvailable(size_t offset, uint64_t bytes, size_t size) {
+  if (bytes > size - offset) {
+    throw InvalidMessage("Message exceeds the buffer");
   }
 }
 
-static size_t sizeOf(
-    const MessagePool &pool, const MessageType &type, const void *data) {
-  return pool.get(type.package, type.name).size(data);
+static size_t checkedStringSize(const uint8_t *data, size_t size) {
+  checkAvailable(0, 4, size);
+  uint32_t length = readLength(data);
+  checkAvailable(4, length, size);
+  return length + 4;
 }
 
-template<typename T>
-static size_t sizeOf(
-    const MessagePool &pool, const ArrayType<T> &type, const void *data) {
-  size_t size;
-  const char *current;
-  if (type.size) {
-    size = *type.size;
-    current = reinterpret_cast<const char *>(data);
-  } else {
-    size = *reinterpret_cast<const uint32_t *>(data);
-    current = reinterpret_cast<const char *>(data) + 4;
-  }
-  if (isDynamic(pool, type.type)) {
-    for (size_t i = 0; i < size; i++) {
-      current += sizeOf(pool, *reinterpret_cast<const T *>(current), current);
-    }
-    return current - reinterpret_cast<const char *>(data);
-  } else {
-    return size * sizeOf(pool, type.type, current);
+// Fixed sizes and offsets are stored in 32 bits, which is also the limit
+// of ROS array length prefixes.
+static uint32_t checkedUint32(uint64_t size) {
+  if (size > 0xffffffffu) {
+    throw CompilationFailed("Message too large");
   }
+  return static_cast<uint32_t>(size);
 }
-                     
-struct CombineDynamicOffsets {
-  boost::function<size_t (const void *)> lhs;
-  boost::function<size_t (const void *)> rhs;
-  CombineDynamicOffsets(
-      boost::function<size_t (const void *)> lhs,
-      boost::function<size_t (const void *)> rhs)
-      : lhs(lhs), rhs(rhs) {}
-  size_t operator()(const void *data) {
-    return lhs(data) + rhs(data);
-  }
-};
 
-// Dynamic array over fixed size elements
-template<typename T>
-struct DynamicOffset {
-  const MessagePool &pool;
-  const T &type;
-  CompiledMessage::AccessPath path;
-
-  DynamicOffset(
-      const MessagePool &pool, const T &type,
-      const CompiledMessage::AccessPath &path)
-      : pool(pool), type(type), path(path) {}
-  size_t operator()(const void *data) {
-    size_t offset = path.offset(data);
-    const void *data_pointer = reinterpret_cast<const void *>(
-        reinterpret_cast<const uint8_t *>(data) + offset);
-    return sizeOf(pool, type, data_pointer) + offset;
-  }
-};
+struct MakeCompiledFieldVisitor
+    : public boost::static_visitor<CompiledMessage::CompiledField> {
+  typedef CompiledMessage::CompiledField CompiledField;
 
-struct MakeAccessPathVisitor
-    : public boost::static_visitor<CompiledMessage::AccessPath> {
-  MakeAccessPathVisitor(
-      const CompiledMessage::AccessPath &path, const MessagePool &pool)
-      : path(path), pool(pool) {}
-  CompiledMessage::AccessPath operator()(const BaseType &type) {
+  MakeCompiledFieldVisitor(
+      const MessagePool &pool,
+      std::vector<boost::shared_ptr<const CompiledMessage> > *sub_messages)
+      : pool(pool), sub_messages(sub_messages) {}
+  CompiledField operator()(const BaseType &type) {
+    CompiledField field = makeField(CompiledField::BASE);
+    field.base_type = type.type;
     if (type.type == BaseType::STRING) {
-      return CompiledMessage::AccessPath::advance(
-          path, DynamicOffset<BaseType>(pool, type, path));
+      field.sizing = CompiledField::STRING_SIZE;
     } else {
-      return CompiledMessage::AccessPath::advance(path, sizeOf(type));
+      field.size = fixedSize(pool, type);
     }
+    return field;
   }
-  CompiledMessage::AccessPath operator()(const MessageType &type) {
-    const CompiledMessage &sub_message = pool.get(type.package, type.name);
-    if (isDynamic(pool, sub_message.message())) {
-      return CompiledMessage::AccessPath::advance(path, DynamicOffset<MessageType>(
-          pool, type, path));
+  CompiledField operator()(const MessageType &type) {
+    CompiledField field = makeField(CompiledField::MESSAGE);
+    const CompiledMessage &message = subMessage(type, &field);
+    if (message.isDynamic()) {
+      field.sizing = CompiledField::MESSAGE_SIZE;
     } else {
       // Since the message is not dynamic, computing its size will not
       // require a data pointer and we can safely pass null.
-      return CompiledMessage::AccessPath::advance(
-          path, sub_message.size(0));
+      field.size = message.size(0);
+    }
+    return field;
+  }
+  CompiledField operator()(const BaseTypeArray &type) {
+    CompiledField field = makeField(CompiledField::BASE_ARRAY);
+    field.base_type = type.type.type;
+    if (type.type.type == BaseType::STRING) {
+      return arrayField(type.size, CompiledField::STRINGS_SIZE, &field);
+    } else {
+      field.element_size = fixedSize(pool, type.type);
+      return arrayField(type.size, CompiledField::ELEMENTS_SIZE, &field);
     }
   }
-  template<typename T>
-  CompiledMessage::AccessPath operator()(const ArrayType<T> &type) {
-    if (isDynamic(pool, type)) {
-      return CompiledMessage::AccessPath::advance(path, DynamicOffset<ArrayType<T> >(
-          pool, type, path));
+  CompiledField operator()(const MessageTypeArray &type) {
+    CompiledField field = makeField(CompiledField::MESSAGE_ARRAY);
+    const CompiledMessage &message = subMessage(type.type, &field);
+    if (message.isDynamic()) {
+      return arrayField(type.size, CompiledField::MESSAGES_SIZE, &field);
     } else {
-      return CompiledMessage::AccessPath::advance(path, sizeOf(pool, type, 0));
+      field.element_size = message.size(0);
+      return arrayField(type.size, CompiledField::ELEMENTS_SIZE, &field);
     }
   }
 
-  const CompiledMessage::AccessPath &path;
+  CompiledField makeField(CompiledField::field_kind kind) {
+    CompiledField field = CompiledField();
+    field.kind = kind;
+    field.sizing = CompiledField::FIXED_SIZE;
+    field.array_length = CompiledField::kUnbounded;
+    return field;
+  }
+  // Arrays of fixed size elements with a fixed length are fixed size
+  // fields.
+  CompiledField arrayField(
+      const boost::optional<size_t> &size,
+      CompiledField::sizing_kind sizing, CompiledField *field) {
+    if (size) {
+      field->array_length = checkedUint32(*size);
+    }
+    if (sizing == CompiledField::ELEMENTS_SIZE && size) {
+      field->size = checkedUint32(
+          static_cast<uint64_t>(*size) * field->element_size);
+    } else {
+      field->sizing = sizing;
+    }
+    return *field;
+  }
+  // Messages used by several fields are only referenced once.
+  const CompiledMessage &subMessage(
+      const MessageType &type, CompiledField *field) {
+    boost::shared_ptr<const CompiledMessage> message =
+        pool.getShared(type.package, type.name);
+    size_t index = 0;
+    while (index < sub_messages->size() &&
+           (*sub_messages)[index] != message) {
+      index++;
+    }
+    if (index == sub_messages->size()) {
+      sub_messages->push_back(message);
+    }
+    field->message = index;
+    return *message;
+  }
+
   const MessagePool &pool;
+  std::vector<boost::shared_ptr<const CompiledMessage> > *sub_messages;
 };
 
-CompiledMessage::AccessPath::AccessPath()
-    : offset_(0), dynamic_offset_(&zero_offset) {
+struct CompiledMessage::FieldPathCache {
+  boost::mutex mutex;
+  std::map<std::string, boost::shared_ptr<const FieldPath> > paths;
 };
 
-CompiledMessage::AccessPath::AccessPath(
-    size_t offset, boost::function<size_t (const void *)> dynamic_offset)
-    : offset_(offset), dynamic_offset_(dynamic_offset) {
+CompiledMessage::CompiledMessage()
+    : strings_(boost::make_shared<StringTable>()),
+      message_(boost::make_shared<ParsedMessage>()),
+      package_(StringTable::kNotFound), name_(StringTable::kNotFound),
+      fingerprint_(StringTable::kNotFound), size_(0),
+      field_paths_(boost::make_shared<FieldPathCache>()) {
+}
+
+CompiledMessage::CompiledMessage(
+    const MessagePool &pool, const boost::shared_ptr<StringTable> &strings,
+    const MessageType &type,
+    const boost::shared_ptr<const ParsedMessage> &message)
+    : strings_(strings), message_(message),
+      package_(strings->intern(type.package)),
+      name_(strings->intern(type.name)),
+      fingerprint_(strings->intern(pool.fingerprint(type.package, type.name))),
+      field_paths_(boost::make_shared<FieldPathCache>()) {
+  uint64_t offset = 0;
+  fields_.reserve(message->fields.size());
+  MakeCompiledFieldVisitor visitor(pool, &sub_messages_);
+  BOOST_FOREACH(const Field &field, message->fields) {
+    CompiledField compiled = boost::apply_visitor(visitor, field.type);
+    compiled.name = strings->intern(field.name);
+    compiled.offset = checkedUint32(offset);
+    compiled.dynamic_rank = dynamic_fields_.size();
+    if (compiled.isDynamic()) {
+      dynamic_fields_.push_back(fields_.size());
+#ifdef GENERIC_MESSAGE_ENABLE_STATISTICS
+      counters_.push_back(statistics::registerCounter(
+          statistics::FIELD_DYNAMIC_OFFSET_EVALUATIONS,
+          type.package + "/" + type.name + "." + field.name));
+#endif
+    }
+    offset += compiled.size;
+    fields_.push_back(compiled);
+  }
+  size_ = checkedUint32(offset);
+}
+
+MessageType CompiledMessage::type() const {
+  if (package_ == StringTable::kNotFound) {
+    return MessageType();
+  }
+  return MessageType(strings_->str(package_), strings_->str(name_));
+}
+
+std::string CompiledMessage::fingerprint() const {
+  if (fingerprint_ == StringTable::kNotFound) {
+    return std::string();
+  }
+  return strings_->str(fingerprint_);
+}
+
+size_t CompiledMessage::fieldIndex(const std::string &field_name) const {
+  size_t field_index;
+  if (!findField(field_name, &field_index)) {
+    throw FieldNotFound(field_name);
+  }
+  return field_index;
 }
 
-bool CompiledMessage::AccessPath::isDynamic() {
-  return dynamic_offset_ != &zero_offset;
+bool CompiledMessage::findField(
+    const std::string &field_name, size_t *field_index) const {
+  for (size_t i = 0; i < fields_.size(); i++) {
+    if (strings_->equals(fields_[i].name, field_name)) {
+      *field_index = i;
+      return true;
+    }
+  }
+  return false;
 }
 
-CompiledMessage::AccessPath CompiledMessage::AccessPath::advance(
-    const AccessPath &path, size_t offset){
-  return AccessPath(path.offset_ + offset, path.dynamic_offset_);
+size_t CompiledMessage::dynamicOffset(size_t count, const void *data) const {
+  const uint8_t *base = reinterpret_cast<const uint8_t *>(data);
+  size_t offset = 0;
+  for (size_t i = 0; i < count; i++) {
+    const CompiledField &field = fields_[dynamic_fields_[i]];
+    GENERIC_MESSAGE_COUNT(statistics::DYNAMIC_OFFSET_EVALUATIONS, 1);
+    GENERIC_MESSAGE_COUNT(counters_[i], 1);
+    offset += dynamicSize(field, base + field.offset + offset);
+  }
+  return offset;
 }
 
-CompiledMessage::AccessPath CompiledMessage::AccessPath::advance(
-    const AccessPath &path,
-    boost::function<size_t (const void *)> dynamic_offset) {
-  return AccessPath(
-      path.offset_, CombineDynamicOffsets(
-          path.dynamic_offset_, dynamic_offset));
+size_t CompiledMessage::dynamicSize(
+    const CompiledField &field, const void *data) const {
+  const uint8_t *current = reinterpret_cast<const uint8_t *>(data);
+  size_t count = field.array_length;
+  if (field.isArray() && field.array_length == CompiledField::kUnbounded) {
+    count = readLength(current);
+    current += 4;
+  }
+  switch (field.sizing) {
+    case CompiledField::STRING_SIZE: {
+      size_t size = readLength(current) + 4;
+      GENERIC_MESSAGE_COUNT(statistics::BYTES_WALKED, size);
+      return size;
+    }
+    case CompiledField::ELEMENTS_SIZE: {
+      // Arrays of fixed size elements are only dynamic because of their
+      // length prefix.
+      size_t size = count * field.element_size + 4;
+      GENERIC_MESSAGE_COUNT(statistics::BYTES_WALKED, size);
+      return size;
+    }
+    case CompiledField::STRINGS_SIZE:
+      for (size_t i = 0; i < count; i++) {
+        size_t size = readLength(current) + 4;
+        GENERIC_MESSAGE_COUNT(statistics::BYTES_WALKED, size);
+        current += size;
+      }
+      break;
+    case CompiledField::MESSAGE_SIZE:
+      return subMessage(field).size(current);
+    case CompiledField::MESSAGES_SIZE: {
+      const CompiledMessage &element = subMessage(field);
+      for (size_t i = 0; i < count; i++) {
+        current += element.size(current);
+      }
+      break;
+    }
+    default:
+      return field.size;
+  }
+  return current - reinterpret_cast<const uint8_t *>(data);
 }
 
-CompiledMessage::CompiledField::CompiledField()
-    : field_(0) {
+size_t CompiledMessage::checkedSize(const void *data, size_t size) const {
+  const uint8_t *base = reinterpret_cast<const uint8_t *>(data);
+  size_t offset = 0;
+  for (size_t i = 0; i < fields_.size(); i++) {
+    offset += checkedFieldSize(i, base + offset, size - offset);
+  }
+  return offset;
 }
 
-CompiledMessage::CompiledField::CompiledField(const CompiledField &src)
-    : field_(src.field_), path_(src.path_) {
+size_t CompiledMessage::checkedFieldSize(
+    size_t field_index, const void *data, size_t size) const {
+  const CompiledField &field = fields_[field_index];
+  const uint8_t *base = reinterpret_cast<const uint8_t *>(data);
+  size_t offset = 0;
+  uint32_t count = field.array_length;
+  if (field.isArray() && field.array_length == CompiledField::kUnbounded) {
+    checkAvailable(0, 4, size);
+    count = readLength(base);
+    offset = 4;
+  }
+  switch (field.sizing) {
+    case CompiledField::STRING_SIZE:
+      offset += checkedStringSize(base + offset, size - offset);
+      break;
+    case CompiledField::ELEMENTS_SIZE: {
+      uint64_t bytes = static_cast<uint64_t>(count) * field.element_size;
+      checkAvailable(offset, bytes, size);
+      offset += bytes;
+      break;
+    }
+    case CompiledField::STRINGS_SIZE:
+      for (uint32_t i = 0; i < count; i++) {
+        offset += checkedStringSize(base + offset, size - offset);
+      }
+      break;
+    case CompiledField::MESSAGE_SIZE:
+      offset += subMessage(field).checkedSize(base + offset, size - offset);
+      break;
+    case CompiledField::MESSAGES_SIZE: {
+      const CompiledMessage &element = subMessage(field);
+      for (uint32_t i = 0; i < count; i++) {
+        offset += element.checkedSize(base + offset, size - offset);
+      }
+      break;
+    }
+    default:
+      checkAvailable(0, field.size, size);
+      return field.size;
+  }
+  return offset;
 }
 
-CompiledMessage::CompiledField::CompiledField(
-    const Field &field, const AccessPath &path)
-    : field_(&field), path_(path) {
+const FieldPath &CompiledMessage::fieldPath(const std::string &path) const {
+  typedef std::map<std::string, boost::shared_ptr<const FieldPath> > PathMap;
+  boost::lock_guard<boost::mutex> lock(field_paths_->mutex);
+  PathMap::const_iterator it = field_paths_->paths.find(path);
+  if (it != field_paths_->paths.end()) {
+    return *it->second;
+  }
+  // Only paths that compile are cached, so probing invalid paths does
+  // not grow the cache.
+  boost::shared_ptr<const FieldPath> compiled(new FieldPath(*this, path));
+  field_paths_->paths.insert(std::make_pair(path, compiled));
+  return *compiled;
 }
 
-CompiledMessage::CompiledMessage(
-    const MessagePool &pool, const ParsedMessage &message)
-    : message_(message) {
-  AccessPath current_path;
-  BOOST_FOREACH(const Field &field, message.fields) {
-    field_access_paths_[field.name] = current_path;
-    MakeAccessPathVisitor visitor(current_path, pool);
-    boost::apply_visitor(visitor, field.type);
-    current_path = visitor.path;
-  }
-  path_to_next_ = current_path;
+size_t CompiledMessage::memoryUsage() const {
+  size_t usage = sizeof(*this) +
+      fields_.capacity() * sizeof(CompiledField) +
+      dynamic_fields_.capacity() * sizeof(uint32_t) +
+      sub_messages_.capacity() *
+          sizeof(boost::shared_ptr<const CompiledMessage>) +
+      counters_.capacity() * sizeof(size_t) +
+      sizeof(FieldPathCache);
+  boost::lock_guard<boost::mutex> lock(field_paths_->mutex);
+  typedef std::map<std::string, boost::shared_ptr<const FieldPath> >::value_type
+      CachedPath;
+  BOOST_FOREACH(const CachedPath &path, field_paths_->paths) {
+    usage += sizeof(CachedPath) + path.first.capacity();
+    if (path.second) {
+      usage += path.second->memoryUsage();
+    }
+  }
+  return usage;
 }
 
 }  // namespace generic_message
@@ -0,0 +1,206 @@
+/**
+ * Copyright (c) 2013, Lorenz Moesenlechner <moesenle@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The names of the contributors may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <generic_message/delta_codec.h>
+
+#include <string.h>
+
+namespace generic_message {
+
+namespace {
+
+// Large blocks such as point cloud data go to memcmp, which is vectorized.
+const size_t kMemcmpSize = 256;
+
+bool equalBytes(const uint8_t *a, const uint8_t *b, size_t size) {
+  if (size >= kMemcmpSize) {
+    return memcmp(a, b, size) == 0;
+  }
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    uint64_t x, y;
+    memcpy(&x, a + i, 8);
+    memcpy(&y, b + i, 8);
+    if (x != y) {
+      return false;
+    }
+  }
+  for (; i < size; i++) {
+    if (a[i] != b[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void append(std::vector<uint8_t> *output, const uint8_t *data, size_t size) {
+  output->insert(output->end(), data, data + size);
+}
+
+bool isSet(const uint8_t *bitmap, size_t bit) {
+  return bitmap[bit / 8] & (1 << (bit % 8));
+}
+
+void checkAvailable(const uint8_t *current, const uint8_t *end, size_t size) {
+  if (size > static_cast<size_t>(end - current)) {
+    throw DeltaFailed("Delta is truncated");
+  }
+}
+
+}  // namespace
+
+DeltaCodec::DeltaCodec(const CompiledMessage &message) {
+  compile(message);
+}
+
+size_t DeltaCodec::encode(
+    const void *reference, const void *data,
+    std::vector<uint8_t> *delta) const {
+  const uint8_t *previous = reinterpret_cast<const uint8_t *>(reference);
+  const uint8_t *current = reinterpret_cast<const uint8_t *>(data);
+  size_t changed = 0;
+  delta->assign(bitmapSize(), 0);
+  for (size_t i = 0; i < segments_.size(); i++) {
+    const Segment &segment = segments_[i];
+    if (!segment.message) {
+      if (!equalBytes(previous, current, segment.size)) {
+        size_t offset = 0;
+        for (size_t j = 0; j < segment.field_count; j++) {
+          size_t field = segment.first_field + j;
+          size_t size = field_sizes_[field];
+          if (!equalBytes(previous + offset, current + offset, size)) {
+            (*delta)[field / 8] |= 1 << (field % 8);
+            append(delta, current + offset, size);
+            changed++;
+          }
+          offset += size;
+        }
+      }
+      previous += segment.size;
+      current += segment.size;
+    } else {
+      size_t previous_size =
+          segment.message->fieldSize(segment.field, previous);
+      size_t size = segment.message->fieldSize(segment.field, current);
+      if (size != previous_size || !equalBytes(previous, current, size)) {
+        size_t field = segment.first_field;
+        (*delta)[field / 8] |= 1 << (field % 8);
+        append(delta, current, size);
+        changed++;
+      }
+      previous += previous_size;
+      current += size;
+    }
+  }
+  return changed;
+}
+
+size_t DeltaCodec::decode(
+    const void *reference, const void *delta, size_t size,
+    std::vector<uint8_t> *data) const {
+  const uint8_t *previous = reinterpret_cast<const uint8_t *>(reference);
+  const uint8_t *bitmap = reinterpret_cast<const uint8_t *>(delta);
+  const uint8_t *end = bitmap + size;
+  checkAvailable(bitmap, end, bitmapSize());
+  const uint8_t *values = bitmap + bitmapSize();
+  data->clear();
+  for (size_t i = 0; i < segments_.size(); i++) {
+    const Segment &segment = segments_[i];
+    if (!segment.message) {
+      size_t offset = 0;
+      for (size_t j = 0; j < segment.field_count; j++) {
+        size_t field = segment.first_field + j;
+        size_t field_size = field_sizes_[field];
+        if (isSet(bitmap, field)) {
+          checkAvailable(values, end, field_size);
+          append(data, values, field_size);
+          values += field_size;
+        } else {
+          append(data, previous + offset, field_size);
+        }
+        offset += field_size;
+      }
+      previous += segment.size;
+    } else {
+      size_t previous_size =
+          segment.message->fieldSize(segment.field, previous);
+      if (isSet(bitmap, segment.first_field)) {
+        size_t field_size;
+        try {
+          field_size = segment.message->checkedFieldSize(
+              segment.field, values, end - values);
+        } catch (const InvalidMessage &) {
+          throw DeltaFailed("Delta is truncated");
+        }
+        append(data, values, field_size);
+        values += field_size;
+      } else {
+        append(data, previous, previous_size);
+      }
+      previous += previous_size;
+    }
+  }
+  return values - bitmap;
+}
+
+void DeltaCodec::compile(const CompiledMessage &message) {
+  const std::vector<CompiledMessage::CompiledField> &fields =
+      message.fields();
+  for (size_t i = 0; i < fields.size(); i++) {
+    const CompiledMessage::CompiledField &field = fields[i];
+    if (field.kind == CompiledMessage::CompiledField::MESSAGE) {
+      compile(message.subMessage(field));
+      continue;
+    }
+    if (field.isDynamic()) {
+      Segment segment = Segment();
+      segment.message = &message;
+      segment.field = i;
+      segment.first_field = field_sizes_.size();
+      segment.field_count = 1;
+      segments_.push_back(segment);
+      field_sizes_.push_back(0);
+      continue;
+    }
+    if (field.size == 0) {
+      // Empty messages and arrays never change.
+      continue;
+    }
+    if (segments_.empty() || segments_.back().message) {
+      Segment segment = Segment();
+      segment.first_field = field_sizes_.size();
+      segments_.push_back(segment);
+    }
+    segments_.back().field_count++;
+    segments_.back().size += field.size;
+    field_sizes_.push_back(field.size);
+  }
+}
+
+}  // namespace generic_message
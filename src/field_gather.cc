@@ -0,0 +1,189 @@
+/**
+ * Copyright (c) 2013, Lorenz Moesenlechner <moesenle@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The names of the contributors may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <generic_message/field_gather.h>
+
+#include <string.h>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define GENERIC_MESSAGE_X86_GATHER
+#endif
+
+namespace generic_message {
+
+namespace {
+
+// Buffers are usually separate allocations, so the hardware prefetcher
+// can not predict the next access. Prefetch this many buffers ahead.
+const size_t kPrefetchDistance = 8;
+
+const uint8_t *fieldAddress(const void *buffer, size_t offset) {
+  return reinterpret_cast<const uint8_t *>(buffer) + offset;
+}
+
+void prefetch(const void *const *buffers, size_t i, size_t count,
+              size_t offset) {
+  if (i + kPrefetchDistance < count) {
+    __builtin_prefetch(fieldAddress(buffers[i + kPrefetchDistance], offset));
+  }
+}
+
+template<size_t Size>
+void gatherFixed(
+    const void *const *buffers, size_t count, size_t offset,
+    uint8_t *output) {
+  for (size_t i = 0; i < count; i++) {
+    prefetch(buffers, i, count, offset);
+    memcpy(output + i * Size, fieldAddress(buffers[i], offset), Size);
+  }
+}
+
+void gatherBytes(
+    const void *const *buffers, size_t count, size_t offset, size_t size,
+    uint8_t *output) {
+  for (size_t i = 0; i < count; i++) {
+    prefetch(buffers, i, count, offset);
+    memcpy(output + i * size, fieldAddress(buffers[i], offset), size);
+  }
+}
+
+typedef void (*GatherFunction)(
+    const void *const *buffers, size_t count, size_t offset,
+    uint8_t *output);
+
+#ifdef GENERIC_MESSAGE_X86_GATHER
+
+// The buffer pointers plus the offset are used as gather indices with a
+// null base, so four fields are loaded with one instruction.
+__attribute__((target("avx2")))
+void gather64Avx2(
+    const void *const *buffers, size_t count, size_t offset,
+    uint8_t *output) {
+  __m256i offsets = _mm256_set1_epi64x(offset);
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    for (size_t j = 0; j < 4; j++) {
+      prefetch(buffers, i + j, count, offset);
+    }
+    __m256i addresses = _mm256_add_epi64(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(buffers + i)),
+        offsets);
+    __m256i values = _mm256_i64gather_epi64(
+        static_cast<const long long *>(0), addresses, 1);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(output + i * 8), values);
+  }
+  gatherFixed<8>(buffers + i, count - i, offset, output + i * 8);
+}
+
+__attribute__((target("avx2")))
+void gather32Avx2(
+    const void *const *buffers, size_t count, size_t offset,
+    uint8_t *output) {
+  __m256i offsets = _mm256_set1_epi64x(offset);
+  size_t i = 0;
+  for (; i + 4 <= count; i += 4) {
+    for (size_t j = 0; j < 4; j++) {
+      prefetch(buffers, i + j, count, offset);
+    }
+    __m256i addresses = _mm256_add_epi64(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(buffers + i)),
+        offsets);
+    __m128i values = _mm256_i64gather_epi32(
+        static_cast<const int *>(0), addresses, 1);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(output + i * 4), values);
+  }
+  gatherFixed<4>(buffers + i, count - i, offset, output + i * 4);
+}
+
+bool hasAvx2() {
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+}
+
+GatherFunction selectGather64() {
+  return hasAvx2() ? &gather64Avx2 : &gatherFixed<8>;
+}
+
+GatherFunction selectGather32() {
+  return hasAvx2() ? &gather32Avx2 : &gatherFixed<4>;
+}
+
+#else
+
+GatherFunction selectGather64() {
+  return &gatherFixed<8>;
+}
+
+GatherFunction selectGather32() {
+  return &gatherFixed<4>;
+}
+
+#endif
+
+}  // namespace
+
+FieldGather::FieldGather(
+    const CompiledMessage &message, const std::string &path)
+    : path_(&message.fieldPath(path)), size_(0) {
+  const CompiledMessage::CompiledField &field = path_->field();
+  if (!path_->isElement() && !field.isDynamic()) {
+    size_ = field.size;
+  } else if (path_->isElement() && !field.hasDynamicElements() &&
+             field.base_type != BaseType::STRING) {
+    size_ = field.element_size;
+  } else {
+    throw GatherFailed(path + " is not a fixed size field");
+  }
+}
+
+void FieldGather::gather(
+    const void *const *buffers, size_t count, void *output) const {
+  static const GatherFunction gather64 = selectGather64();
+  static const GatherFunction gather32 = selectGather32();
+  uint8_t *bytes = reinterpret_cast<uint8_t *>(output);
+  if (path_->isDynamic()) {
+    for (size_t i = 0; i < count; i++) {
+      prefetch(buffers, i, count, 0);
+      memcpy(bytes + i * size_,
+             fieldAddress(buffers[i], path_->offset(buffers[i])), size_);
+    }
+    return;
+  }
+  size_t offset = path_->offset(0);
+  switch (size_) {
+    case 1: gatherFixed<1>(buffers, count, offset, bytes); break;
+    case 2: gatherFixed<2>(buffers, count, offset, bytes); break;
+    case 4: gather32(buffers, count, offset, bytes); break;
+    case 8: gather64(buffers, count, offset, bytes); break;
+    default: gatherBytes(buffers, count, offset, size_, bytes); break;
+  }
+}
+
+}  // namespace generic_message
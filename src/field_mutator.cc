@@ -0,0 +1,183 @@
+/**
+ * Copyright (c) 2013, Lorenz Moesenlechner <moesenle@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The names of the contributors may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <generic_message/field_mutator.h>
+
+#include <boost/lexical_cast.hpp>
+
+namespace generic_message {
+
+namespace {
+
+typedef CompiledMessage::CompiledField CompiledField;
+
+uint8_t *bufferData(MessageBuffer *buffer) {
+  return buffer->data();
+}
+
+uint8_t *bufferData(std::vector<uint8_t> *buffer) {
+  return buffer->empty() ? 0 : &(*buffer)[0];
+}
+
+uint8_t *splice(
+    MessageBuffer *buffer, size_t offset, size_t old_size, size_t new_size) {
+  return buffer->splice(offset, old_size, new_size);
+}
+
+uint8_t *splice(
+    std::vector<uint8_t> *buffer, size_t offset, size_t old_size,
+    size_t new_size) {
+  size_t tail = buffer->size() - offset - old_size;
+  if (new_size > old_size) {
+    buffer->resize(buffer->size() + new_size - old_size);
+  }
+  if (new_size != old_size && tail > 0) {
+    memmove(&(*buffer)[offset + new_size], &(*buffer)[offset + old_size],
+            tail);
+  }
+  if (new_size < old_size) {
+    buffer->resize(buffer->size() - (old_size - new_size));
+  }
+  return bufferData(buffer) + offset;
+}
+
+void writeLength(uint8_t *data, size_t length) {
+  uint32_t prefix = length;
+  memcpy(data, &prefix, 4);
+}
+
+}  // namespace
+
+FieldMutator::FieldMutator(
+    const CompiledMessage &message, const std::string &path)
+    : path_(&message.fieldPath(path)), kind_(OTHER), size_(0),
+      element_size_(0) {
+  const CompiledField &field = path_->field();
+  bool strings = field.base_type == BaseType::STRING &&
+      (field.kind == CompiledField::BASE ||
+       field.kind == CompiledField::BASE_ARRAY);
+  if (path_->isElement()) {
+    if (strings) {
+      kind_ = STRING;
+    } else if (!field.hasDynamicElements()) {
+      kind_ = FIXED;
+      size_ = field.element_size;
+    }
+  } else if (strings && field.kind == CompiledField::BASE) {
+    kind_ = STRING;
+  } else if (!field.isDynamic()) {
+    kind_ = FIXED;
+    size_ = field.size;
+    element_size_ = field.element_size;
+  } else if (field.sizing == CompiledField::ELEMENTS_SIZE) {
+    kind_ = ARRAY;
+    element_size_ = field.element_size;
+  }
+}
+
+void FieldMutator::setTime(void *data, uint32_t sec, uint32_t nsec) const {
+  uint32_t value[2] = {sec, nsec};
+  set(data, value);
+}
+
+void FieldMutator::setString(
+    MessageBuffer *buffer, const std::string &value) const {
+  writeString(buffer, value);
+}
+
+void FieldMutator::setString(
+    std::vector<uint8_t> *buffer, const std::string &value) const {
+  writeString(buffer, value);
+}
+
+void FieldMutator::setArray(
+    MessageBuffer *buffer, const void *elements, size_t count) const {
+  writeArray(buffer, elements, count);
+}
+
+void FieldMutator::setArray(
+    std::vector<uint8_t> *buffer, const void *elements, size_t count) const {
+  writeArray(buffer, elements, count);
+}
+
+void FieldMutator::replace(
+    MessageBuffer *buffer, const void *value, size_t size) const {
+  memcpy(resize(buffer, size), value, size);
+}
+
+void FieldMutator::replace(
+    std::vector<uint8_t> *buffer, const void *value, size_t size) const {
+  memcpy(resize(buffer, size), value, size);
+}
+
+void FieldMutator::checkFixed(size_t size) const {
+  if (kind_ != FIXED || size != size_) {
+    throw MutationFailed(
+        path_->path() + " is not a fixed size field of " +
+        boost::lexical_cast<std::string>(size) + " bytes");
+  }
+}
+
+template<typename Buffer>
+uint8_t *FieldMutator::resize(Buffer *buffer, size_t size) const {
+  uint8_t *data = bufferData(buffer);
+  size_t offset = path_->offset(data);
+  return splice(buffer, offset, path_->size(data), size);
+}
+
+template<typename Buffer>
+void FieldMutator::writeString(
+    Buffer *buffer, const std::string &value) const {
+  if (kind_ != STRING) {
+    throw MutationFailed(path_->path() + " is not a string");
+  }
+  uint8_t *field = resize(buffer, value.size() + 4);
+  writeLength(field, value.size());
+  memcpy(field + 4, value.data(), value.size());
+}
+
+template<typename Buffer>
+void FieldMutator::writeArray(
+    Buffer *buffer, const void *elements, size_t count) const {
+  size_t size = count * element_size_;
+  if (kind_ == FIXED && element_size_ && size == size_) {
+    uint8_t *data = bufferData(buffer);
+    memcpy(data + path_->offset(data), elements, size);
+  } else if (kind_ == ARRAY) {
+    uint8_t *field = resize(buffer, size + 4);
+    writeLength(field, count);
+    memcpy(field + 4, elements, size);
+  } else {
+    throw MutationFailed(
+        path_->path() + " is not an array of " +
+        boost::lexical_cast<std::string>(count) + " fixed size elements");
+  }
+}
+
+}  // namespace generic_message
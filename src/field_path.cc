@@ -0,0 +1,232 @@
+/**
+ * Copyright (c) 2013, Lorenz Moesenlechner <moesenle@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The names of the contributors may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <generic_message/field_path.h>
+
+#include <string.h>
+
+#include <limits>
+
+#include <boost/lexical_cast.hpp>
+
+namespace generic_message {
+
+namespace {
+
+struct PathSegment {
+  std::string name;
+  boost::optional<size_t> index;
+};
+
+bool isNameCharacter(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+      (c >= '0' && c <= '9') || c == '_';
+}
+
+std::vector<PathSegment> splitPath(const std::string &path) {
+  std::vector<PathSegment> segments;
+  size_t position = 0;
+  while (true) {
+    PathSegment segment;
+    size_t begin = position;
+    while (position < path.size() && isNameCharacter(path[position])) {
+      position++;
+    }
+    segment.name = path.substr(begin, position - begin);
+    if (segment.name.empty()) {
+      throw FieldNotFound("Invalid field path: " + path);
+    }
+    if (position < path.size() && path[position] == '[') {
+      size_t end = path.find(']', position);
+      if (end == std::string::npos || end == position + 1) {
+        throw FieldNotFound("Invalid field path: " + path);
+      }
+      try {
+        segment.index = boost::lexical_cast<size_t>(
+            path.substr(position + 1, end - position - 1));
+      } catch (const boost::bad_lexical_cast &) {
+        throw FieldNotFound("Invalid array index in field path: " + path);
+      }
+      // Array lengths are 32 bit, and steps store indices as such.
+      if (*segment.index > std::numeric_limits<uint32_t>::max()) {
+        throw FieldNotFound("Array index out of range in field path: " + path);
+      }
+      position = end + 1;
+    }
+    segments.push_back(segment);
+    if (position == path.size()) {
+      return segments;
+    }
+    if (path[position] != '.') {
+      throw FieldNotFound("Invalid field path: " + path);
+    }
+    position++;
+  }
+}
+
+uint32_t readLength(const uint8_t *data) {
+  // Length prefixes are not necessarily aligned.
+  uint32_t length;
+  memcpy(&length, data, sizeof(length));
+  return length;
+}
+
+}  // namespace
+
+FieldPath::FieldPath(const CompiledMessage &message, const std::string &path)
+    : path_(path), offset_(0), message_(0), field_(0), element_(false) {
+  std::vector<PathSegment> segments = splitPath(path);
+  const CompiledMessage *current = &message;
+  for (size_t i = 0; i < segments.size(); i++) {
+    const PathSegment &segment = segments[i];
+    if (!current) {
+      throw FieldNotFound(
+          path + ": " + segments[i - 1].name + " is not a message");
+    }
+    size_t field_index;
+    if (!current->findField(segment.name, &field_index)) {
+      throw FieldNotFound(path + ": no field " + segment.name);
+    }
+    const CompiledMessage::CompiledField &field =
+        current->fields()[field_index];
+    if (field.dynamic_rank) {
+      Step step(Step::FIELD);
+      step.message = current;
+      step.index = field.dynamic_rank;
+      steps_.push_back(step);
+    }
+    addOffset(field.offset);
+    message_ = current;
+    field_ = field_index;
+    element_ = static_cast<bool>(segment.index);
+    type_ = current->message().fields[field_index].type;
+    if (segment.index) {
+      if (const BaseTypeArray *array = boost::get<BaseTypeArray>(&type_)) {
+        type_ = BaseType(array->type);
+      } else if (const MessageTypeArray *array =
+                 boost::get<MessageTypeArray>(&type_)) {
+        type_ = MessageType(array->type);
+      } else {
+        throw FieldNotFound(path + ": " + segment.name + " is not an array");
+      }
+      addIndex(*current, field, *segment.index);
+    }
+    if (boost::get<MessageType>(&type_)) {
+      current = &current->subMessage(field);
+    } else {
+      current = 0;
+    }
+  }
+}
+
+void FieldPath::addIndex(
+    const CompiledMessage &message,
+    const CompiledMessage::CompiledField &field, size_t index) {
+  if (field.array_length != CompiledMessage::CompiledField::kUnbounded) {
+    if (index >= field.array_length) {
+      throw FieldNotFound(path_ + ": index out of range");
+    }
+  } else {
+    Step step(Step::CHECK_LENGTH);
+    step.index = index;
+    steps_.push_back(step);
+    addOffset(4);
+  }
+  if (!field.hasDynamicElements()) {
+    addOffset(index * field.element_size);
+  } else if (index > 0) {
+    Step step(Step::SKIP_STRINGS);
+    if (field.sizing == CompiledMessage::CompiledField::MESSAGES_SIZE) {
+      step.kind = Step::SKIP_MESSAGES;
+      step.message = &message.subMessage(field);
+    }
+    step.index = index;
+    steps_.push_back(step);
+  }
+}
+
+size_t FieldPath::evaluate(const void *data) const {
+  const uint8_t *base = reinterpret_cast<const uint8_t *>(data);
+  size_t offset = offset_;
+  for (size_t i = 0; i < steps_.size(); i++) {
+    const Step &step = steps_[i];
+    switch (step.kind) {
+      case Step::FIELD:
+        offset += step.message->dynamicOffset(step.index, base + offset);
+        break;
+      case Step::CHECK_LENGTH:
+        if (readLength(base + offset) <= step.index) {
+          throw IndexOutOfRange(path_);
+        }
+        break;
+      case Step::SKIP_STRINGS:
+        for (uint32_t j = 0; j < step.index; j++) {
+          offset += readLength(base + offset) + 4;
+        }
+        break;
+      case Step::SKIP_MESSAGES:
+        for (uint32_t j = 0; j < step.index; j++) {
+          offset += step.message->size(base + offset);
+        }
+        break;
+    }
+    offset += step.offset;
+  }
+  return offset;
+}
+
+size_t FieldPath::size(const void *data) const {
+  const uint8_t *base = reinterpret_cast<const uint8_t *>(data) + offset(data);
+  if (!element_) {
+    return message_->fieldSize(field_, base);
+  }
+  const CompiledMessage::CompiledField &field = this->field();
+  switch (field.sizing) {
+    case CompiledMessage::CompiledField::STRINGS_SIZE:
+      return readLength(base) + 4;
+    case CompiledMessage::CompiledField::MESSAGES_SIZE:
+      return message_->subMessage(field).size(base);
+    default:
+      return field.element_size;
+  }
+}
+
+size_t FieldPath::memoryUsage() const {
+  return sizeof(*this) + path_.capacity() + steps_.capacity() * sizeof(Step);
+}
+
+void FieldPath::addOffset(size_t offset) {
+  if (steps_.empty()) {
+    offset_ += offset;
+  } else {
+    steps_.back().offset += offset;
+  }
+}
+
+}  // namespace generic_message
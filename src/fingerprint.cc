@@ -0,0 +1,114 @@
+/**
+ * Copyright (c) 2013, Lorenz Moesenlechner <moesenle@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The names of the contributors may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <generic_message/fingerprint.h>
+
+#include <boost/foreach.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include <generic_message/md5.h>
+#include <generic_message/message_pool.h>
+
+namespace generic_message {
+
+namespace {
+
+const char *baseTypeName(const BaseType &type) {
+  switch (type.type) {
+    case BaseType::BOOL: return "bool";
+    case BaseType::INT8: return "int8";
+    case BaseType::UINT8: return "uint8";
+    case BaseType::INT16: return "int16";
+    case BaseType::UINT16: return "uint16";
+    case BaseType::INT32: return "int32";
+    case BaseType::UINT32: return "uint32";
+    case BaseType::INT64: return "int64";
+    case BaseType::UINT64: return "uint64";
+    case BaseType::FLOAT32: return "float32";
+    case BaseType::FLOAT64: return "float64";
+    case BaseType::STRING: return "string";
+    case BaseType::TIME: return "time";
+    case BaseType::DURATION: return "duration";
+    default:
+      throw CompilationFailed(
+          "Unknown base type: " + boost::lexical_cast<std::string>(type.type));
+  }
+}
+
+struct FingerprintTypeVisitor : public boost::static_visitor<std::string> {
+  FingerprintTypeVisitor(const MessagePool &pool) : pool(pool) {}
+  std::string operator()(const BaseType &type) const {
+    return baseTypeName(type);
+  }
+  std::string operator()(const MessageType &type) const {
+    return pool.fingerprint(type.package, type.name);
+  }
+  std::string operator()(const BaseTypeArray &type) const {
+    std::string result = baseTypeName(type.type);
+    if (type.size) {
+      return result + "[" + boost::lexical_cast<std::string>(*type.size) + "]";
+    } else {
+      return result + "[]";
+    }
+  }
+  // Arrays of messages are hashed like a single message.
+  std::string operator()(const MessageTypeArray &type) const {
+    return (*this)(type.type);
+  }
+
+  const MessagePool &pool;
+};
+
+}  // namespace
+
+std::string fingerprintText(
+    const MessagePool &pool, const ParsedMessage &message) {
+  FingerprintTypeVisitor visitor(pool);
+  std::string result;
+  BOOST_FOREACH(const Constant &constant, message.constants) {
+    result += boost::apply_visitor(visitor, constant.type) + " " +
+        constant.name + "=" + constant.text + "\n";
+  }
+  BOOST_FOREACH(const Field &field, message.fields) {
+    result += boost::apply_visitor(visitor, field.type) + " " +
+        field.name + "\n";
+  }
+  // ROS strips the trailing new line.
+  if (!result.empty()) {
+    result.erase(result.size() - 1);
+  }
+  return result;
+}
+
+std::string computeFingerprint(
+    const MessagePool &pool, const ParsedMessage &message) {
+  return md5(fingerprintText(pool, message));
+}
+
+}  // namespace generic_message
@@ -0,0 +1,953 @@
+/**
+ * Copyright (c) 2013, Lorenz Moesenlechner <moesenle@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The names of the contributors may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <generic_message/json_encoder.h>
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <limits>
+#include <sstream>
+
+#if __cplusplus >= 201703L
+#include <charconv>
+#endif
+
+namespace generic_message {
+
+namespace {
+
+typedef CompiledMessage::CompiledField CompiledField;
+
+const uint32_t kMissing = 0xffffffff;
+const size_t kMaxDepth = 512;
+
+bool isDigit(char c) {
+  return c >= '0' && c <= '9';
+}
+
+int hexValue(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  } else if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  } else if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+
+// Parses the four hexadecimal digits of a \u escape sequence.
+int parseHex4(const char *text) {
+  int value = 0;
+  for (int i = 0; i < 4; i++) {
+    int digit = hexValue(text[i]);
+    if (digit < 0) {
+      return -1;
+    }
+    value = value * 16 + digit;
+  }
+  return value;
+}
+
+char *appendUtf8(uint32_t code_point, char *out) {
+  if (code_point < 0x80) {
+    *out++ = code_point;
+  } else if (code_point < 0x800) {
+    *out++ = 0xc0 | (code_point >> 6);
+    *out++ = 0x80 | (code_point & 0x3f);
+  } else if (code_point < 0x10000) {
+    *out++ = 0xe0 | (code_point >> 12);
+    *out++ = 0x80 | ((code_point >> 6) & 0x3f);
+    *out++ = 0x80 | (code_point & 0x3f);
+  } else {
+    *out++ = 0xf0 | (code_point >> 18);
+    *out++ = 0x80 | ((code_point >> 12) & 0x3f);
+    *out++ = 0x80 | ((code_point >> 6) & 0x3f);
+    *out++ = 0x80 | (code_point & 0x3f);
+  }
+  return out;
+}
+
+// Decodes a string that has been validated by the tokenizer.
+void unescape(const char *text, size_t length, char *out) {
+  const char *end = text + length;
+  while (text < end) {
+    if (*text != '\\') {
+      *out++ = *text++;
+      continue;
+    }
+    text++;
+    switch (*text++) {
+      case 'b': *out++ = '\b'; break;
+      case 'f': *out++ = '\f'; break;
+      case 'n': *out++ = '\n'; break;
+      case 'r': *out++ = '\r'; break;
+      case 't': *out++ = '\t'; break;
+      case 'u': {
+        uint32_t code_point = parseHex4(text);
+        text += 4;
+        if (code_point >= 0xd800 && code_point < 0xdc00) {
+          uint32_t low = parseHex4(text + 2);
+          text += 6;
+          code_point = 0x10000 + ((code_point - 0xd800) << 10) + (low - 0xdc00);
+        }
+        out = appendUtf8(code_point, out);
+        break;
+      }
+      default:
+        *out++ = text[-1];
+    }
+  }
+}
+
+int base64Value(char c) {
+  if (c >= 'A' && c <= 'Z') {
+    return c - 'A';
+  } else if (c >= 'a' && c <= 'z') {
+    return c - 'a' + 26;
+  } else if (c >= '0' && c <= '9') {
+    return c - '0' + 52;
+  } else if (c == '+') {
+    return 62;
+  } else if (c == '/') {
+    return 63;
+  }
+  return -1;
+}
+
+// Decodes base64 with or without padding into out if out is not null.
+// Returns false if text is not valid base64.
+bool decodeBase64(
+    const char *text, size_t length, uint8_t *out, size_t *size) {
+  if (length % 4 == 0 && length > 0 && text[length - 1] == '=') {
+    length -= text[length - 2] == '=' ? 2 : 1;
+  }
+  if (length % 4 == 1) {
+    return false;
+  }
+  *size = length / 4 * 3 + (length % 4 ? length % 4 - 1 : 0);
+  uint32_t bits = 0;
+  size_t bit_count = 0;
+  for (size_t i = 0; i < length; i++) {
+    int value = base64Value(text[i]);
+    if (value < 0) {
+      return false;
+    }
+    bits = (bits << 6) | value;
+    bit_count += 6;
+    if (bit_count >= 8) {
+      bit_count -= 8;
+      if (out) {
+        *out++ = bits >> bit_count;
+      }
+    }
+  }
+  return true;
+}
+
+// Splits a JSON document into tokens and validates its syntax.
+class Tokenizer {
+ public:
+  Tokenizer(const char *json, size_t length, std::vector<JsonToken> *tokens)
+      : json_(json), length_(length), position_(0), tokens_(tokens) {}
+
+  void run() {
+    if (length_ >= kMissing) {
+      throw EncodingFailed("JSON document too large");
+    }
+    tokens_->clear();
+    skipSpace();
+    value(0);
+    skipSpace();
+    if (position_ != length_) {
+      fail("Unexpected trailing characters");
+    }
+  }
+
+ private:
+  const char *json_;
+  size_t length_;
+  size_t position_;
+  std::vector<JsonToken> *tokens_;
+
+  __attribute__((noreturn))
+  void fail(const std::string &message) const {
+    std::ostringstream error;
+    error << message << " at offset " << position_;
+    throw EncodingFailed(error.str());
+  }
+
+  char peek() const {
+    return position_ < length_ ? json_[position_] : 0;
+  }
+
+  void skipSpace() {
+    while (position_ < length_ &&
+           (json_[position_] == ' ' || json_[position_] == '\n' ||
+            json_[position_] == '\r' || json_[position_] == '\t')) {
+      position_++;
+    }
+  }
+
+  void expect(char c) {
+    if (peek() != c) {
+      fail(std::string("Expected '") + c + "'");
+    }
+    position_++;
+  }
+
+  size_t push(JsonToken::token_type type, size_t begin) {
+    JsonToken token;
+    token.type = type;
+    token.escaped = false;
+    token.begin = begin;
+    token.length = 0;
+    token.count = 0;
+    token.next = tokens_->size() + 1;
+    tokens_->push_back(token);
+    return tokens_->size() - 1;
+  }
+
+  void finish(size_t index, size_t begin, uint32_t count) {
+    JsonToken &token = (*tokens_)[index];
+    token.length = position_ - begin;
+    token.count = count;
+    token.next = tokens_->size();
+  }
+
+  void value(size_t depth) {
+    if (depth > kMaxDepth) {
+      fail("JSON document nested too deeply");
+    }
+    switch (peek()) {
+      case '{': object(depth); break;
+      case '[': array(depth); break;
+      case '"': string(); break;
+      case 't': literal("true", JsonToken::TRUE_VALUE); break;
+      case 'f': literal("false", JsonToken::FALSE_VALUE); break;
+      case 'n': literal("null", JsonToken::NULL_VALUE); break;
+      default: number();
+    }
+  }
+
+  void object(size_t depth) {
+    size_t begin = position_;
+    size_t index = push(JsonToken::OBJECT, begin);
+    uint32_t count = 0;
+    position_++;
+    skipSpace();
+    if (peek() == '}') {
+      position_++;
+    } else {
+      while (true) {
+        skipSpace();
+        if (peek() != '"') {
+          fail("Expected member name");
+        }
+        string();
+        skipSpace();
+        expect(':');
+        skipSpace();
+        value(depth + 1);
+        count++;
+        skipSpace();
+        if (peek() != ',') {
+          break;
+        }
+        position_++;
+      }
+      expect('}');
+    }
+    finish(index, begin, count);
+  }
+
+  void array(size_t depth) {
+    size_t begin = position_;
+    size_t index = push(JsonToken::ARRAY, begin);
+    uint32_t count = 0;
+    position_++;
+    skipSpace();
+    if (peek() == ']') {
+      position_++;
+    } else {
+      while (true) {
+        skipSpace();
+        value(depth + 1);
+        count++;
+        skipSpace();
+        if (peek() != ',') {
+          break;
+        }
+        position_++;
+      }
+      expect(']');
+    }
+    finish(index, begin, count);
+  }
+
+  void string() {
+    position_++;
+    size_t begin = position_;
+    size_t index = push(JsonToken::STRING, begin);
+    uint32_t decoded = 0;
+    while (true) {
+      if (position_ >= length_) {
+        fail("Unterminated string");
+      }
+      uint8_t c = json_[position_];
+      if (c == '"') {
+        break;
+      } else if (c < 0x20) {
+        fail("Control character in string");
+      } else if (c != '\\') {
+        position_++;
+        decoded++;
+        continue;
+      }
+      (*tokens_)[index].escaped = true;
+      position_++;
+      switch (peek()) {
+        case '"': case '\\': case '/':
+        case 'b': case 'f': case 'n': case 'r': case 't':
+          position_++;
+          decoded++;
+          break;
+        case 'u':
+          decoded += unicodeEscape();
+          break;
+        default:
+          fail("Invalid escape sequence");
+      }
+    }
+    finish(index, begin, decoded);
+    position_++;
+  }
+
+  // Validates a \u escape sequence, which may be a surrogate pair, and
+  // returns the length of its UTF-8 encoding.
+  uint32_t unicodeEscape() {
+    position_++;
+    int code_point = position_ + 4 <= length_ ? parseHex4(json_ + position_) : -1;
+    if (code_point < 0) {
+      fail("Invalid unicode escape");
+    }
+    position_ += 4;
+    if (code_point >= 0xdc00 && code_point < 0xe000) {
+      fail("Unpaired surrogate");
+    } else if (code_point >= 0xd800 && code_point < 0xdc00) {
+      int low = -1;
+      if (position_ + 6 <= length_ && json_[position_] == '\\' &&
+          json_[position_ + 1] == 'u') {
+        low = parseHex4(json_ + position_ + 2);
+      }
+      if (low < 0xdc00 || low >= 0xe000) {
+        fail("Unpaired surrogate");
+      }
+      position_ += 6;
+      return 4;
+    }
+    return code_point < 0x80 ? 1 : code_point < 0x800 ? 2 : 3;
+  }
+
+  void literal(const char *text, JsonToken::token_type type) {
+    size_t length = strlen(text);
+    if (length_ - position_ < length ||
+        memcmp(json_ + position_, text, length) != 0) {
+      fail("Invalid literal");
+    }
+    size_t index = push(type, position_);
+    position_ += length;
+    (*tokens_)[index].length = length;
+  }
+
+  void number() {
+    size_t begin = position_;
+    if (peek() == '-') {
+      position_++;
+    }
+    if (peek() == '0') {
+      position_++;
+    } else if (isDigit(peek())) {
+      digits();
+    } else {
+      fail("Unexpected character");
+    }
+    if (peek() == '.') {
+      position_++;
+      if (!isDigit(peek())) {
+        fail("Invalid number");
+      }
+      digits();
+    }
+    if (peek() == 'e' || peek() == 'E') {
+      position_++;
+      if (peek() == '+' || peek() == '-') {
+        position_++;
+      }
+      if (!isDigit(peek())) {
+        fail("Invalid number");
+      }
+      digits();
+    }
+    size_t index = push(JsonToken::NUMBER, begin);
+    (*tokens_)[index].length = position_ - begin;
+  }
+
+  void digits() {
+    while (isDigit(peek())) {
+      position_++;
+    }
+  }
+};
+
+// Parses a number without fraction or exponent. Returns false for other
+// numbers and for integers that do not fit in 64 bits.
+bool parseInteger(
+    const char *text, size_t length, bool *negative, uint64_t *magnitude) {
+  const char *end = text + length;
+  *negative = text < end && *text == '-';
+  if (*negative) {
+    text++;
+  }
+  uint64_t value = 0;
+  for (; text < end; text++) {
+    if (!isDigit(*text)) {
+      return false;
+    }
+    uint64_t digit = *text - '0';
+    if (value > (std::numeric_limits<uint64_t>::max() - digit) / 10) {
+      return false;
+    }
+    value = value * 10 + digit;
+  }
+  *magnitude = value;
+  return true;
+}
+
+double parseDouble(const char *text, size_t length) {
+#if defined(__cpp_lib_to_chars)
+  double value = 0;
+  std::from_chars(text, text + length, value);
+  return value;
+#else
+  // The text is not terminated, and valid numbers are short.
+  char buffer[64];
+  if (length >= sizeof(buffer)) {
+    return strtod(std::string(text, length).c_str(), 0);
+  }
+  memcpy(buffer, text, length);
+  buffer[length] = 0;
+  return strtod(buffer, 0);
+#endif
+}
+
+// Counts the size of the encoded message.
+class SizeOutput {
+ public:
+  // Values that cannot be out of range do not need to be converted.
+  static const bool kConvertsValues = false;
+
+  SizeOutput() : size_(0) {}
+  template<typename T>
+  void value(T) { size_ += sizeof(T); }
+  void zero(size_t size) { size_ += size; }
+  // Returns where size bytes are to be written, or null if they do not
+  // need to be written.
+  uint8_t *reserve(size_t size) {
+    size_ += size;
+    return 0;
+  }
+  size_t size() const { return size_; }
+
+ private:
+  size_t size_;
+};
+
+class BufferOutput {
+ public:
+  static const bool kConvertsValues = true;
+
+  BufferOutput(uint8_t *data) : position_(data) {}
+  template<typename T>
+  void value(T value) {
+    memcpy(position_, &value, sizeof(T));
+    position_ += sizeof(T);
+  }
+  void zero(size_t size) {
+    memset(position_, 0, size);
+    position_ += size;
+  }
+  uint8_t *reserve(size_t size) {
+    uint8_t *result = position_;
+    position_ += size;
+    return result;
+  }
+
+ private:
+  uint8_t *position_;
+};
+
+template<typename Output>
+class Encoder {
+ public:
+  Encoder(
+      const char *json, const std::vector<JsonToken> &tokens,
+      std::string *key, Output *output)
+      : json_(json), tokens_(tokens), key_(key), output_(output),
+        message_(0), field_(0) {}
+
+  // Encodes the object at token, or a message with default values if
+  // token is kMissing.
+  void message(const CompiledMessage &message, uint32_t token) {
+    const std::vector<CompiledField> &fields = message.fields();
+    if (token == kMissing) {
+      for (size_t i = 0; i < fields.size(); i++) {
+        field(message, fields[i], kMissing);
+      }
+      return;
+    }
+    const JsonToken &object = tokens_[token];
+    if (object.type != JsonToken::OBJECT) {
+      message_ = &message;
+      field_ = 0;
+      fail("expected an object");
+    }
+    // Members are looked up starting after the previous match, so that
+    // members in the order of the definition are found immediately.
+    uint32_t first = token + 1;
+    uint32_t cursor = first;
+    uint32_t matched = 0;
+    for (size_t i = 0; i < fields.size(); i++) {
+      uint32_t value = kMissing;
+      if (object.count) {
+        const char *name = message.fieldName(i);
+        uint32_t name_length = message.strings().length(fields[i].name);
+        uint32_t key = cursor;
+        do {
+          uint32_t following = tokens_[key + 1].next;
+          if (following == object.next) {
+            following = first;
+          }
+          if (keyEquals(key, name, name_length)) {
+            value = key + 1;
+            cursor = following;
+            matched++;
+            break;
+          }
+          key = following;
+        } while (key != cursor);
+      }
+      field(message, fields[i], value);
+    }
+    if (matched != object.count) {
+      unknownMember(message, token);
+    }
+  }
+
+ private:
+  const char *json_;
+  const std::vector<JsonToken> &tokens_;
+  std::string *key_;
+  Output *output_;
+  // The field that is being encoded, for error messages.
+  const CompiledMessage *message_;
+  const CompiledField *field_;
+
+  __attribute__((noreturn))
+  void fail(const std::string &error) const {
+    std::string location;
+    if (message_) {
+      MessageType type = message_->type();
+      location = type.package + "/" + type.name;
+      if (field_) {
+        location += std::string(".") +
+            message_->strings().str(field_->name);
+      }
+      location += ": ";
+    }
+    throw EncodingFailed(location + error);
+  }
+
+  void field(
+      const CompiledMessage &message, const CompiledField &field,
+      uint32_t token) {
+    message_ = &message;
+    field_ = &field;
+    switch (field.kind) {
+      case CompiledField::BASE:
+        base(message, field.base_type, token);
+        break;
+      case CompiledField::MESSAGE:
+        this->message(message.subMessage(field), token);
+        break;
+      default:
+        array(message, field, token);
+    }
+  }
+
+  void array(
+      const CompiledMessage &message, const CompiledField &field,
+      uint32_t token) {
+    bool bounded = field.array_length != CompiledField::kUnbounded;
+    uint32_t count = bounded ? field.array_length : 0;
+    if (token != kMissing) {
+      const JsonToken &value = tokens_[token];
+      if (value.type == JsonToken::STRING &&
+          field.kind == CompiledField::BASE_ARRAY &&
+          (field.base_type == BaseType::UINT8 ||
+           field.base_type == BaseType::INT8)) {
+        base64(field, value);
+        return;
+      }
+      if (value.type != JsonToken::ARRAY) {
+        fail("expected an array");
+      }
+      if (bounded && value.count != count) {
+        std::ostringstream error;
+        error << "expected " << count << " elements";
+        fail(error.str());
+      }
+      count = value.count;
+    }
+    if (!bounded) {
+      output_->template value<uint32_t>(count);
+    }
+    if (token == kMissing && !field.hasDynamicElements()) {
+      output_->zero(static_cast<size_t>(count) * field.element_size);
+      return;
+    }
+    uint32_t element = token == kMissing ? kMissing : token + 1;
+    for (uint32_t i = 0; i < count; i++) {
+      if (field.kind == CompiledField::BASE_ARRAY) {
+        base(message, field.base_type, element);
+      } else {
+        this->message(message.subMessage(field), element);
+        message_ = &message;
+        field_ = &field;
+      }
+      if (element != kMissing) {
+        element = tokens_[element].next;
+      }
+    }
+  }
+
+  void base64(const CompiledField &field, const JsonToken &value) {
+    if (value.escaped) {
+      fail("invalid base64 string");
+    }
+    size_t size;
+    if (!decodeBase64(json_ + value.begin, value.length, 0, &size)) {
+      fail("invalid base64 string");
+    }
+    if (field.array_length != CompiledField::kUnbounded) {
+      if (size != field.array_length) {
+        std::ostringstream error;
+        error << "expected " << field.array_length << " elements";
+        fail(error.str());
+      }
+    } else {
+      if (size >= kMissing) {
+        fail("array too long");
+      }
+      output_->template value<uint32_t>(size);
+    }
+    if (uint8_t *out = output_->reserve(size)) {
+      decodeBase64(json_ + value.begin, value.length, out, &size);
+    }
+  }
+
+  void base(
+      const CompiledMessage &message, uint8_t base_type, uint32_t token) {
+    switch (base_type) {
+      case BaseType::BOOL: {
+        uint8_t value = 0;
+        if (token != kMissing && tokens_[token].type == JsonToken::TRUE_VALUE) {
+          value = 1;
+        } else if (token != kMissing &&
+                   tokens_[token].type != JsonToken::FALSE_VALUE) {
+          value = integer<uint8_t>(message, token);
+          if (value > 1) {
+            fail("expected a boolean");
+          }
+        }
+        output_->template value<uint8_t>(value);
+        break;
+      }
+      case BaseType::INT8:
+        output_->template value<int8_t>(integer<int8_t>(message, token));
+        break;
+      case BaseType::UINT8:
+        output_->template value<uint8_t>(integer<uint8_t>(message, token));
+        break;
+      case BaseType::INT16:
+        output_->template value<int16_t>(integer<int16_t>(message, token));
+        break;
+      case BaseType::UINT16:
+        output_->template value<uint16_t>(integer<uint16_t>(message, token));
+        break;
+      case BaseType::INT32:
+        output_->template value<int32_t>(integer<int32_t>(message, token));
+        break;
+      case BaseType::UINT32:
+        output_->template value<uint32_t>(integer<uint32_t>(message, token));
+        break;
+      case BaseType::INT64:
+        output_->template value<int64_t>(integer<int64_t>(message, token));
+        break;
+      case BaseType::UINT64:
+        output_->template value<uint64_t>(integer<uint64_t>(message, token));
+        break;
+      case BaseType::FLOAT32:
+        output_->template value<float>(floating(message, token));
+        break;
+      case BaseType::FLOAT64:
+        output_->template value<double>(floating(message, token));
+        break;
+      case BaseType::STRING:
+        string(token);
+        break;
+      case BaseType::TIME:
+        time<uint32_t>(message, token);
+        break;
+      case BaseType::DURATION:
+        time<int32_t>(message, token);
+        break;
+      default:
+        fail("unsupported type");
+    }
+  }
+
+  void string(uint32_t token) {
+    if (token == kMissing) {
+      output_->template value<uint32_t>(0);
+      return;
+    }
+    const JsonToken &value = tokens_[token];
+    if (value.type != JsonToken::STRING) {
+      fail("expected a string");
+    }
+    output_->template value<uint32_t>(value.count);
+    if (uint8_t *out = output_->reserve(value.count)) {
+      if (value.escaped) {
+        unescape(json_ + value.begin, value.length, reinterpret_cast<char *>(out));
+      } else {
+        memcpy(out, json_ + value.begin, value.length);
+      }
+    }
+  }
+
+  template<typename T>
+  void time(const CompiledMessage &message, uint32_t token) {
+    T sec = 0;
+    T nsec = 0;
+    if (token != kMissing) {
+      const JsonToken &object = tokens_[token];
+      if (object.type != JsonToken::OBJECT) {
+        fail("expected an object with sec and nsec");
+      }
+      uint32_t key = token + 1;
+      for (uint32_t i = 0; i < object.count; i++) {
+        if (keyEquals(key, "sec", 3) || keyEquals(key, "secs", 4)) {
+          sec = integer<T>(message, key + 1);
+        } else if (keyEquals(key, "nsec", 4) || keyEquals(key, "nsecs", 5)) {
+          nsec = integer<T>(message, key + 1);
+        } else {
+          fail("expected an object with sec and nsec");
+        }
+        key = tokens_[key + 1].next;
+      }
+    }
+    output_->template value<T>(sec);
+    output_->template value<T>(nsec);
+  }
+
+  template<typename T>
+  T integer(const CompiledMessage &message, uint32_t token) {
+    if (token == kMissing) {
+      return 0;
+    }
+    const JsonToken &value = tokens_[token];
+    bool negative;
+    uint64_t magnitude;
+    if (value.type == JsonToken::NUMBER) {
+      if (parseInteger(
+              json_ + value.begin, value.length, &negative, &magnitude)) {
+        return checkedInteger<T>(negative, magnitude);
+      }
+      return integralDouble<T>(parseDouble(json_ + value.begin, value.length));
+    } else if (value.type == JsonToken::STRING) {
+      const ConstantValueType &constant_value = constant(message, value);
+      if (const long long *number = boost::get<long long>(&constant_value)) {
+        return checkedInteger<T>(
+            *number < 0,
+            *number < 0 ? 0 - static_cast<uint64_t>(*number) : *number);
+      } else if (const bool *flag = boost::get<bool>(&constant_value)) {
+        return *flag;
+      } else if (const double *number = boost::get<double>(&constant_value)) {
+        return integralDouble<T>(*number);
+      }
+      fail("constant is not a number");
+    }
+    fail("expected an integer");
+    return 0;
+  }
+
+  template<typename T>
+  T checkedInteger(bool negative, uint64_t magnitude) {
+    if (negative && magnitude) {
+      uint64_t limit =
+          static_cast<uint64_t>(-(std::numeric_limits<T>::min() + 1)) + 1;
+      if (!std::numeric_limits<T>::is_signed || magnitude > limit) {
+        fail("value out of range");
+      }
+      return static_cast<T>(-static_cast<int64_t>(magnitude - 1) - 1);
+    }
+    if (magnitude > static_cast<uint64_t>(std::numeric_limits<T>::max())) {
+      fail("value out of range");
+    }
+    return static_cast<T>(magnitude);
+  }
+
+  template<typename T>
+  T integralDouble(double value) {
+    // max() + 1 is a power of two and exact, unlike max() of 64 bit types.
+    if (!(value >= static_cast<double>(std::numeric_limits<T>::min()) &&
+          value < static_cast<double>(std::numeric_limits<T>::max()) + 1.0)) {
+      fail("value out of range");
+    }
+    if (value != floor(value)) {
+      fail("expected an integer");
+    }
+    return static_cast<T>(value);
+  }
+
+  double floating(const CompiledMessage &message, uint32_t token) {
+    if (token == kMissing) {
+      return 0;
+    }
+    const JsonToken &value = tokens_[token];
+    switch (value.type) {
+      case JsonToken::NUMBER:
+        if (!Output::kConvertsValues) {
+          return 0;
+        }
+        return parseDouble(json_ + value.begin, value.length);
+      case JsonToken::NULL_VALUE:
+        return std::numeric_limits<double>::quiet_NaN();
+      case JsonToken::STRING: {
+        const ConstantValueType &constant_value = constant(message, value);
+        if (const double *number = boost::get<double>(&constant_value)) {
+          return *number;
+        } else if (const long long *number =
+                   boost::get<long long>(&constant_value)) {
+          return *number;
+        }
+        fail("constant is not a number");
+      }
+      default:
+        fail("expected a number");
+    }
+    return 0;
+  }
+
+  const ConstantValueType &constant(
+      const CompiledMessage &message, const JsonToken &name) {
+    const std::vector<Constant> &constants = message.message().constants;
+    for (size_t i = 0; i < constants.size(); i++) {
+      if (!name.escaped && constants[i].name.size() == name.length &&
+          memcmp(constants[i].name.data(), json_ + name.begin,
+                 name.length) == 0) {
+        return constants[i].value;
+      }
+    }
+    fail("unknown constant " + std::string(json_ + name.begin, name.length));
+    return constants[0].value;
+  }
+
+  bool keyEquals(uint32_t token, const char *name, uint32_t length) {
+    const JsonToken &key = tokens_[token];
+    if (key.count != length) {
+      return false;
+    }
+    if (!key.escaped) {
+      return memcmp(json_ + key.begin, name, length) == 0;
+    }
+    key_->resize(key.count);
+    unescape(json_ + key.begin, key.length, &(*key_)[0]);
+    return memcmp(key_->data(), name, length) == 0;
+  }
+
+  void unknownMember(const CompiledMessage &message, uint32_t token) {
+    message_ = &message;
+    field_ = 0;
+    uint32_t key = token + 1;
+    for (uint32_t i = 0; i < tokens_[token].count; i++) {
+      size_t field_index;
+      std::string name(json_ + tokens_[key].begin, tokens_[key].length);
+      if (tokens_[key].escaped) {
+        name.resize(tokens_[key].count);
+        unescape(json_ + tokens_[key].begin, tokens_[key].length, &name[0]);
+      }
+      if (!message.findField(name, &field_index)) {
+        fail("unknown field " + name);
+      }
+      key = tokens_[key + 1].next;
+    }
+    fail("duplicate field");
+  }
+};
+
+}  // namespace
+
+JsonEncoder::JsonEncoder() {
+}
+
+void JsonEncoder::encode(
+    const CompiledMessage &message, const std::string &json,
+    std::vector<uint8_t> *output) {
+  encode(message, json.data(), json.size(), output);
+}
+
+void JsonEncoder::encode(
+    const CompiledMessage &message, const char *json, size_t length,
+    std::vector<uint8_t> *output) {
+  Tokenizer(json, length, &tokens_).run();
+  SizeOutput size;
+  Encoder<SizeOutput>(json, tokens_, &key_, &size).message(message, 0);
+  output->resize(size.size());
+  if (size.size() == 0) {
+    return;
+  }
+  BufferOutput buffer(&(*output)[0]);
+  Encoder<BufferOutput>(json, tokens_, &key_, &buffer).message(message, 0);
+}
+
+}  // namespace generic_message
@@ -0,0 +1,83 @@
+/**
+ * Copyright (c) 2013, Lorenz Moesenlechner <moesenle@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The names of the contributors may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <generic_message/message_buffer.h>
+
+#include <string.h>
+
+#include <algorithm>
+
+namespace generic_message {
+
+const size_t MessageBuffer::kDefaultSlack;
+
+MessageBuffer::MessageBuffer(const void *data, size_t size, size_t slack)
+    : size_(0) {
+  assign(data, size, slack);
+}
+
+void MessageBuffer::assign(const void *data, size_t size, size_t slack) {
+  if (bytes_.size() < size + slack) {
+    bytes_.resize(size + slack);
+  }
+  if (size > 0) {
+    memcpy(&bytes_[0], data, size);
+  }
+  size_ = size;
+}
+
+void MessageBuffer::reserve(size_t capacity) {
+  if (capacity > bytes_.size()) {
+    bytes_.resize(capacity);
+  }
+}
+
+uint8_t *MessageBuffer::splice(
+    size_t offset, size_t old_size, size_t new_size) {
+  size_t tail = size_ - offset - old_size;
+  size_t size = size_ - old_size + new_size;
+  if (size > bytes_.size()) {
+    // Growing copies everything anyway, so head and tail are copied to
+    // their final places instead of being moved after the copy.
+    std::vector<uint8_t> bytes(size + size / 4);
+    if (offset > 0) {
+      memcpy(&bytes[0], data(), offset);
+    }
+    if (tail > 0) {
+      memcpy(&bytes[offset + new_size], data() + offset + old_size, tail);
+    }
+    bytes_.swap(bytes);
+  } else if (new_size != old_size) {
+    memmove(data() + offset + new_size, data() + offset + old_size, tail);
+  }
+  size_ = size;
+  return data() + offset;
+}
+
+}  // namespace generic_message
@@ -29,6 +29,8 @@
 
 #include <generic_message/parsed_message.h>
 
+#include <stdlib.h>
+
 #include <vector>
 
 #include <boost/spirit/include/qi.hpp>
@@ -47,6 +49,23 @@ namespace qi = boost::spirit::qi;
 namespace ascii = boost::spirit::ascii;
 namespace phoenix = boost::phoenix;
 
+// Constants keep the text of their value so that fingerprints can be
+// computed from the definition as written.
+static Constant makeBoolConstant(
+    const BaseType &type, const std::string &name, const std::string &text) {
+  return Constant(type, name, text == "true", text);
+}
+
+static Constant makeFixedNumberConstant(
+    const BaseType &type, const std::string &name, const std::string &text) {
+  return Constant(type, name, strtoll(text.c_str(), 0, 10), text);
+}
+
+static Constant makeFloatingPointConstant(
+    const BaseType &type, const std::string &name, const std::string &text) {
+  return Constant(type, name, strtod(text.c_str(), 0), text);
+}
+
 template<typename Iterator>
 struct SkipGrammar 
     : qi::grammar<Iterator> {
@@ -78,9 +97,9 @@ struct MessageGrammar
   qi::rule<Iterator, MessageTypeArray(), SkipGrammar<Iterator> > message_type_array;  
   qi::rule<Iterator, Type(), SkipGrammar<Iterator> > type;
   qi::rule<Iterator, Field(), SkipGrammar<Iterator> > field;
-  qi::rule<Iterator, bool(), SkipGrammar<Iterator> > bool_constant;
-  qi::rule<Iterator, long long(), SkipGrammar<Iterator> > fixed_number_constant;
-  qi::rule<Iterator, double(), SkipGrammar<Iterator> > floating_point_constant;
+  qi::rule<Iterator, std::string(), SkipGrammar<Iterator> > bool_constant;
+  qi::rule<Iterator, std::string(), SkipGrammar<Iterator> > fixed_number_constant;
+  qi::rule<Iterator, std::string(), SkipGrammar<Iterator> > floating_point_constant;
   qi::rule<Iterator, std::string(), SkipGrammar<Iterator> > string_constant;
   qi::rule<Iterator, Constant(), SkipGrammar<Iterator> > constant;
   qi::rule<Iterator, ParsedMessage(), SkipGrammar<Iterator> > message;
@@ -94,6 +113,7 @@ struct MessageGrammar
   MessageGrammar() : MessageGrammar::base_type(message) {
     using qi::lit;
     using qi::lexeme;
+    using qi::raw;
     using qi::eol;
     using spirit::ulong_;
     using spirit::bool_;
@@ -146,18 +166,18 @@ struct MessageGrammar
 
     field = (type >> identifier >> eol) [ _val = construct<Field>(_1, _2) ];
 
-    bool_constant %= bool_;
-    fixed_number_constant %= long_long;
-    floating_point_constant %= double_;
+    bool_constant %= raw[bool_];
+    fixed_number_constant %= raw[long_long];
+    floating_point_constant %= raw[double_];
     string_constant %= lexeme[*(char_ - eol) >> &eol];
     
     constant =
         (bool_type >> identifier >> lit('=') >> bool_constant) [
-            _val = construct<Constant>(_1, _2, _3) ]
+            _val = bind(&makeBoolConstant, _1, _2, _3) ]
         | (fixed_number_types >> identifier >> lit('=') >> fixed_number_constant) [
-            _val = construct<Constant>(_1, _2, _3) ]
+            _val = bind(&makeFixedNumberConstant, _1, _2, _3) ]
         | (floating_point_types >> identifier >> lit('=') >> floating_point_constant) [
-            _val = construct<Constant>(_1, _2, _3) ]
+            _val = bind(&makeFloatingPointConstant, _1, _2, _3) ]
         | (string_type >> identifier >> lit('=') >> string_constant) [
             _val = construct<Constant>(_1, _2, _3) ];
 
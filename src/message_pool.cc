@@ -29,9 +29,15 @@
 
 #include "generic_message/message_pool.h"
 
+#include <algorithm>
+#include <vector>
+
 #include <boost/foreach.hpp>
+#include <boost/thread/locks.hpp>
 
+#include <generic_message/fingerprint.h>
 #include <generic_message/message_parser.h>
+#include <generic_message/statistics.h>
 
 namespace generic_message {
 
@@ -53,12 +59,82 @@ struct FixMessageTypeVisitor : public boost::static_visitor<> {
   const std::string &current_package;
 };
 
+struct CollectDependenciesVisitor : public boost::static_visitor<> {
+  CollectDependenciesVisitor(std::set<std::string> *dependencies)
+      : dependencies(dependencies) {}
+  void operator()(const BaseType &) {}
+  void operator()(const BaseTypeArray &) {}
+  void operator()(const MessageType &type) {
+    dependencies->insert(type.package + "/" + type.name);
+  }
+  void operator()(const MessageTypeArray &type) {
+    (*this)(type.type);
+  }
+  std::set<std::string> *dependencies;
+};
+
+struct TypeMemoryUsageVisitor : public boost::static_visitor<size_t> {
+  size_t operator()(const BaseType &) const { return 0; }
+  size_t operator()(const BaseTypeArray &) const { return 0; }
+  size_t operator()(const MessageType &type) const {
+    return type.package.capacity() + type.name.capacity();
+  }
+  size_t operator()(const MessageTypeArray &type) const {
+    return (*this)(type.type);
+  }
+};
+
+static size_t parsedMessageMemoryUsage(const ParsedMessage &message) {
+  size_t usage = sizeof(message) +
+      message.constants.capacity() * sizeof(Constant) +
+      message.fields.capacity() * sizeof(Field);
+  BOOST_FOREACH(const Constant &constant, message.constants) {
+    usage += boost::apply_visitor(TypeMemoryUsageVisitor(), constant.type) +
+        constant.name.capacity() + constant.text.capacity();
+    if (const std::string *value = boost::get<std::string>(&constant.value)) {
+      usage += value->capacity();
+    }
+  }
+  BOOST_FOREACH(const Field &field, message.fields) {
+    usage += boost::apply_visitor(TypeMemoryUsageVisitor(), field.type) +
+        field.name.capacity();
+  }
+  return usage;
+}
+
+MessagePool::MessagePool()
+    : strings_(new StringTable()) {
+}
+
 void MessagePool::add(
     const std::string &package, const std::string &name,
     const ParsedMessage &message) {
-  
-  known_messages_[make_key(package, name)] =
-      CompiledMessage(*this, message);
+  boost::lock_guard<boost::recursive_mutex> lock(mutex_);
+  uint32_t id = makeKey(package, name);
+  Definition &definition = definitions_[id];
+  BOOST_FOREACH(uint32_t dependency, definition.dependencies) {
+    std::vector<uint32_t> &dependents = dependents_[dependency];
+    std::vector<uint32_t>::iterator it =
+        std::find(dependents.begin(), dependents.end(), id);
+    if (it != dependents.end()) {
+      dependents.erase(it);
+    }
+  }
+  definition.package = strings_->intern(package);
+  definition.name = strings_->intern(name);
+  definition.message.reset(new ParsedMessage(message));
+  std::set<std::string> dependencies;
+  CollectDependenciesVisitor visitor(&dependencies);
+  BOOST_FOREACH(const Field &field, message.fields) {
+    boost::apply_visitor(visitor, field.type);
+  }
+  definition.dependencies.clear();
+  BOOST_FOREACH(const std::string &dependency, dependencies) {
+    uint32_t dependency_id = strings_->intern(dependency);
+    definition.dependencies.push_back(dependency_id);
+    dependents_[dependency_id].push_back(id);
+  }
+  invalidate(id);
 }
 
 void MessagePool::add(
@@ -72,23 +148,237 @@ void MessagePool::add(
   BOOST_FOREACH(Field &field, parsed_message.fields) {
     boost::apply_visitor(visitor, field.type);
   }
-  known_messages_[make_key(package, name)] =
-      CompiledMessage(*this, parsed_message);
+  add(package, name, parsed_message);
 }
 
 const CompiledMessage &MessagePool::get(
     const std::string &package, const std::string &name) const {
-  std::map<std::string, CompiledMessage>::const_iterator it =
-      known_messages_.find(make_key(package, name));
-  if (it == known_messages_.end()) {
-    throw MessageNotFound(package + "/" + name);
+  boost::lock_guard<boost::recursive_mutex> lock(mutex_);
+  return *getShared(package, name);
+}
+
+boost::shared_ptr<const CompiledMessage> MessagePool::getShared(
+    const std::string &package, const std::string &name) const {
+  boost::lock_guard<boost::recursive_mutex> lock(mutex_);
+  // Only lookups by users are counted, not the ones of the pool itself
+  // while compiling, invalidating or fingerprinting.
+  GENERIC_MESSAGE_COUNT(statistics::POOL_GET_CALLS, 1);
+  try {
+    return compile(lookup(package, name));
+  } catch (const MessageNotFound &) {
+    GENERIC_MESSAGE_COUNT(statistics::POOL_GET_MISSES, 1);
+    throw;
   }
-  return it->second;
 }
 
-std::string MessagePool::make_key(
+const CompiledMessage &MessagePool::getByFingerprint(
+    const std::string &fingerprint) const {
+  boost::lock_guard<boost::recursive_mutex> lock(mutex_);
+  GENERIC_MESSAGE_COUNT(statistics::POOL_GET_CALLS, 1);
+  indexFingerprints();
+  boost::unordered_multimap<uint32_t, uint32_t>::const_iterator it =
+      fingerprints_.find(strings_->find(fingerprint));
+  if (it == fingerprints_.end()) {
+    GENERIC_MESSAGE_COUNT(statistics::POOL_GET_MISSES, 1);
+    throw MessageNotFound(fingerprint);
+  }
+  return *compile(it->second);
+}
+
+std::string MessagePool::fingerprint(
+    const std::string &package, const std::string &name) const {
+  boost::lock_guard<boost::recursive_mutex> lock(mutex_);
+  return strings_->str(fingerprint(lookup(package, name)));
+}
+
+MessagePool::MemoryUsage MessagePool::memoryUsage() const {
+  boost::lock_guard<boost::recursive_mutex> lock(mutex_);
+  // Hash nodes hold a value and a next pointer, buckets a pointer.
+  const size_t node_overhead = 2 * sizeof(void *);
+  MemoryUsage usage;
+  usage.strings = strings_->count();
+  usage.string_bytes = strings_->memoryUsage();
+  usage.definitions = definitions_.size();
+  usage.definition_bytes = sizeof(*this) +
+      definitions_.bucket_count() * sizeof(void *) +
+      dependents_.bucket_count() * sizeof(void *) +
+      fingerprints_.bucket_count() * sizeof(void *) +
+      fingerprints_.size() *
+          (sizeof(std::pair<uint32_t, uint32_t>) + node_overhead) +
+      unindexed_.size() * (sizeof(uint32_t) + 4 * sizeof(void *));
+  typedef boost::unordered_map<uint32_t, Definition>::value_type
+      DefinitionEntry;
+  BOOST_FOREACH(const DefinitionEntry &entry, definitions_) {
+    const Definition &definition = entry.second;
+    usage.definition_bytes += sizeof(DefinitionEntry) + node_overhead +
+        definition.dependencies.capacity() * sizeof(uint32_t);
+    if (definition.message) {
+      usage.definition_bytes += parsedMessageMemoryUsage(*definition.message);
+    }
+    if (definition.compiled) {
+      usage.compiled_messages++;
+      usage.compiled_fields += definition.compiled->fields().size();
+      usage.compiled_bytes += definition.compiled->memoryUsage();
+    }
+  }
+  typedef boost::unordered_map<uint32_t, std::vector<uint32_t> >::value_type
+      DependentsEntry;
+  BOOST_FOREACH(const DependentsEntry &entry, dependents_) {
+    usage.definition_bytes += sizeof(DependentsEntry) + node_overhead +
+        entry.second.capacity() * sizeof(uint32_t);
+  }
+  return usage;
+}
+
+uint32_t MessagePool::makeKey(
+    const std::string &package, const std::string &name) {
+  return strings_->intern(package + "/" + name);
+}
+
+uint32_t MessagePool::lookup(
     const std::string &package, const std::string &name) const {
-  return package + "/" + name;
+  std::string key = package + "/" + name;
+  uint32_t id = strings_->find(key);
+  if (id == StringTable::kNotFound) {
+    throw MessageNotFound(key);
+  }
+  return id;
+}
+
+MessagePool::Definition &MessagePool::find(uint32_t id) const {
+  boost::unordered_map<uint32_t, Definition>::iterator it =
+      definitions_.find(id);
+  if (it == definitions_.end()) {
+    throw MessageNotFound(strings_->str(id));
+  }
+  return it->second;
+}
+
+const boost::shared_ptr<const CompiledMessage> &MessagePool::compile(
+    uint32_t id) const {
+  Definition &definition = find(id);
+  if (definition.compiled) {
+    return definition.compiled;
+  }
+  if (definition.compiling) {
+    throw CompilationFailed(
+        std::string("Recursive message definition: ") + strings_->str(id));
+  }
+#ifdef GENERIC_MESSAGE_ENABLE_STATISTICS
+  uint64_t start = statistics::now();
+#endif
+  definition.compiling = true;
+  try {
+    definition.compiled.reset(new CompiledMessage(
+        *this, strings_,
+        MessageType(
+            strings_->str(definition.package), strings_->str(definition.name)),
+        definition.message));
+  } catch (...) {
+    definition.compiling = false;
+    throw;
+  }
+  definition.compiling = false;
+  GENERIC_MESSAGE_COUNT(
+      statistics::registerCounter(
+          statistics::TYPE_COMPILATIONS, strings_->str(id)), 1);
+  GENERIC_MESSAGE_COUNT(
+      statistics::registerCounter(
+          statistics::TYPE_COMPILE_TIME_NS, strings_->str(id)),
+      statistics::now() - start);
+  return definition.compiled;
+}
+
+uint32_t MessagePool::fingerprint(uint32_t id) const {
+  Definition &definition = find(id);
+  if (definition.fingerprint != StringTable::kNotFound) {
+    return definition.fingerprint;
+  }
+  if (definition.fingerprinting) {
+    throw CompilationFailed(
+        std::string("Recursive message definition: ") + strings_->str(id));
+  }
+  definition.fingerprinting = true;
+  try {
+    definition.fingerprint = strings_->intern(
+        computeFingerprint(*this, *definition.message));
+  } catch (...) {
+    definition.fingerprinting = false;
+    throw;
+  }
+  definition.fingerprinting = false;
+  return definition.fingerprint;
+}
+
+void MessagePool::indexFingerprints() const {
+  BOOST_FOREACH(uint32_t id, unindexed_) {
+    fingerprints_.insert(std::make_pair(fingerprint(id), id));
+  }
+  unindexed_.clear();
+}
+
+bool MessagePool::checkComplete(uint32_t id) {
+  boost::unordered_map<uint32_t, Definition>::iterator it =
+      definitions_.find(id);
+  if (it == definitions_.end()) {
+    return false;
+  }
+  Definition &definition = it->second;
+  if (definition.completeness != Definition::UNKNOWN) {
+    return definition.completeness == Definition::COMPLETE;
+  }
+  // Recursive definitions reach their own id again and are never
+  // complete.
+  definition.completeness = Definition::INCOMPLETE;
+  BOOST_FOREACH(uint32_t dependency, definition.dependencies) {
+    if (!checkComplete(dependency)) {
+      return false;
+    }
+  }
+  definition.completeness = Definition::COMPLETE;
+  unindexed_.insert(id);
+  return true;
+}
+
+// Adding a definition can only change the messages that depend on it, so
+// only those are checked for completeness again.
+void MessagePool::invalidate(uint32_t id) {
+  std::set<uint32_t> visited;
+  std::vector<uint32_t> pending(1, id);
+  while (!pending.empty()) {
+    uint32_t current = pending.back();
+    pending.pop_back();
+    if (!visited.insert(current).second) {
+      continue;
+    }
+    boost::unordered_map<uint32_t, Definition>::iterator definition =
+        definitions_.find(current);
+    if (definition != definitions_.end()) {
+      typedef boost::unordered_multimap<uint32_t, uint32_t>::iterator
+          FingerprintIterator;
+      std::pair<FingerprintIterator, FingerprintIterator> range =
+          fingerprints_.equal_range(definition->second.fingerprint);
+      for (FingerprintIterator it = range.first; it != range.second; ++it) {
+        if (it->second == current) {
+          fingerprints_.erase(it);
+          break;
+        }
+      }
+      definition->second.compiled.reset();
+      definition->second.fingerprint = StringTable::kNotFound;
+      definition->second.completeness = Definition::UNKNOWN;
+      unindexed_.erase(current);
+    }
+    boost::unordered_map<uint32_t, std::vector<uint32_t> >::const_iterator
+        dependents = dependents_.find(current);
+    if (dependents != dependents_.end()) {
+      pending.insert(
+          pending.end(), dependents->second.begin(), dependents->second.end());
+    }
+  }
+  BOOST_FOREACH(uint32_t current, visited) {
+    checkComplete(current);
+  }
 }
 
 }  // namespace generic_message
@@ -0,0 +1,476 @@
+/**
+ * Copyright (c) 2013, Lorenz Moesenlechner <moesenle@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The names of the contributors may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <generic_message/message_printer.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <limits>
+
+#if __cplusplus >= 201703L
+#include <charconv>
+#endif
+
+namespace generic_message {
+
+namespace {
+
+typedef CompiledMessage::CompiledField CompiledField;
+
+const char kDigits[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233"
+    "34353637383940414243444546474849505152535455565758596061626364656667"
+    "6869707172737475767778798081828384858687888990919293949596979899";
+
+template<typename T>
+T read(const uint8_t *data) {
+  T value;
+  memcpy(&value, data, sizeof(T));
+  return value;
+}
+
+// Writes value right aligned in front of end and returns the first digit.
+char *formatUnsigned(uint64_t value, char *end) {
+  while (value >= 100) {
+    size_t index = (value % 100) * 2;
+    value /= 100;
+    *--end = kDigits[index + 1];
+    *--end = kDigits[index];
+  }
+  if (value >= 10) {
+    *--end = kDigits[value * 2 + 1];
+    *--end = kDigits[value * 2];
+  } else {
+    *--end = '0' + value;
+  }
+  return end;
+}
+
+void appendUnsigned(std::string *output, uint64_t value) {
+  char buffer[20];
+  char *end = buffer + sizeof(buffer);
+  output->append(formatUnsigned(value, end), end);
+}
+
+void appendSigned(std::string *output, int64_t value) {
+  char buffer[21];
+  char *end = buffer + sizeof(buffer);
+  char *begin = formatUnsigned(
+      value < 0 ? 0 - static_cast<uint64_t>(value) : value, end);
+  if (value < 0) {
+    *--begin = '-';
+  }
+  output->append(begin, end);
+}
+
+// Shortest representation that parses back to the same value.
+#if defined(__cpp_lib_to_chars)
+template<typename T>
+size_t formatFloat(T value, char *buffer, size_t size) {
+  return std::to_chars(buffer, buffer + size, value).ptr - buffer;
+}
+#else
+size_t formatFloat(float value, char *buffer, size_t size) {
+  int length = snprintf(buffer, size, "%.6g", value);
+  if (strtof(buffer, 0) != value) {
+    length = snprintf(buffer, size, "%.9g", value);
+  }
+  return length;
+}
+
+size_t formatFloat(double value, char *buffer, size_t size) {
+  int length = snprintf(buffer, size, "%.15g", value);
+  if (strtod(buffer, 0) != value) {
+    length = snprintf(buffer, size, "%.17g", value);
+  }
+  return length;
+}
+#endif
+
+template<typename T>
+void appendFloat(std::string *output, T value, bool json) {
+  // JSON has no representation for NaN and infinity.
+  if (value != value) {
+    output->append(json ? "null" : ".nan");
+    return;
+  } else if (value == std::numeric_limits<T>::infinity()) {
+    output->append(json ? "null" : ".inf");
+    return;
+  } else if (value == -std::numeric_limits<T>::infinity()) {
+    output->append(json ? "null" : "-.inf");
+    return;
+  }
+  char buffer[32];
+  size_t length = formatFloat(value, buffer, sizeof(buffer));
+  // Print 1 as 1.0 and 1e+300 as 1.0e+300 so that the values still read
+  // as floating point numbers, also for YAML 1.1 parsers.
+  size_t mantissa = length;
+  for (size_t i = 0; i < length; i++) {
+    if (buffer[i] == '.') {
+      output->append(buffer, length);
+      return;
+    } else if (buffer[i] == 'e') {
+      mantissa = i;
+      break;
+    }
+  }
+  output->append(buffer, mantissa);
+  output->append(".0");
+  output->append(buffer + mantissa, length - mantissa);
+}
+
+void appendString(
+    std::string *output, const uint8_t *data, size_t length, bool json) {
+  static const char kHex[] = "0123456789abcdef";
+  output->push_back('"');
+  const char *characters = reinterpret_cast<const char *>(data);
+  size_t run = 0;
+  for (size_t i = 0; i < length; i++) {
+    uint8_t c = data[i];
+    if (c >= 0x20 && c != '"' && c != '\\' && c != 0x7f) {
+      continue;
+    }
+    output->append(characters + run, i - run);
+    run = i + 1;
+    output->push_back('\\');
+    switch (c) {
+      case '"': output->push_back('"'); break;
+      case '\\': output->push_back('\\'); break;
+      case '\n': output->push_back('n'); break;
+      case '\r': output->push_back('r'); break;
+      case '\t': output->push_back('t'); break;
+      default:
+        output->append(json ? "u00" : "x");
+        output->push_back(kHex[c >> 4]);
+        output->push_back(kHex[c & 0xf]);
+    }
+  }
+  output->append(characters + run, length - run);
+  output->push_back('"');
+}
+
+class Writer {
+ public:
+  Writer(std::string *output, bool json, size_t max_array_length)
+      : output_(output), json_(json), max_array_length_(max_array_length) {}
+
+  void message(const CompiledMessage &message, const uint8_t *data) {
+    if (json_) {
+      jsonMessage(message, data);
+    } else if (message.fields().empty()) {
+      output_->append("{}\n");
+    } else {
+      yamlFields(message, data, 0, false);
+    }
+  }
+
+ private:
+  std::string *output_;
+  bool json_;
+  size_t max_array_length_;
+
+  const uint8_t *jsonMessage(
+      const CompiledMessage &message, const uint8_t *data) {
+    const std::vector<CompiledField> &fields = message.fields();
+    output_->push_back('{');
+    for (size_t i = 0; i < fields.size(); i++) {
+      const CompiledField &field = fields[i];
+      if (i > 0) {
+        output_->push_back(',');
+      }
+      output_->push_back('"');
+      name(message, field);
+      output_->append("\":");
+      switch (field.kind) {
+        case CompiledField::BASE:
+          data = value(field.base_type, data);
+          break;
+        case CompiledField::MESSAGE:
+          data = jsonMessage(message.subMessage(field), data);
+          break;
+        default: {
+          size_t count = arrayLength(field, &data);
+          size_t shown = shownElements(count);
+          output_->push_back('[');
+          for (size_t j = 0; j < shown; j++) {
+            if (j > 0) {
+              output_->push_back(',');
+            }
+            data = field.kind == CompiledField::BASE_ARRAY
+                ? value(field.base_type, data)
+                : jsonMessage(message.subMessage(field), data);
+          }
+          if (shown < count) {
+            output_->push_back(',');
+            more(count - shown);
+            data = skip(message, field, data, count - shown);
+          }
+          output_->push_back(']');
+        }
+      }
+    }
+    output_->push_back('}');
+    return data;
+  }
+
+  // Prints one line per field. If continuation is true, the first field
+  // continues the current line, which starts an element of a list.
+  const uint8_t *yamlFields(
+      const CompiledMessage &message, const uint8_t *data, size_t indent,
+      bool continuation) {
+    const std::vector<CompiledField> &fields = message.fields();
+    for (size_t i = 0; i < fields.size(); i++) {
+      const CompiledField &field = fields[i];
+      if (i > 0 || !continuation) {
+        output_->append(indent, ' ');
+      }
+      name(message, field);
+      output_->push_back(':');
+      switch (field.kind) {
+        case CompiledField::BASE:
+          if (field.base_type == BaseType::TIME ||
+              field.base_type == BaseType::DURATION) {
+            data = yamlTime(field.base_type, data, indent + 2);
+          } else {
+            output_->push_back(' ');
+            data = value(field.base_type, data);
+            output_->push_back('\n');
+          }
+          break;
+        case CompiledField::MESSAGE:
+          data = yamlMessage(message.subMessage(field), data, indent + 2);
+          break;
+        case CompiledField::BASE_ARRAY: {
+          size_t count = arrayLength(field, &data);
+          size_t shown = shownElements(count);
+          output_->append(" [");
+          for (size_t j = 0; j < shown; j++) {
+            if (j > 0) {
+              output_->append(", ");
+            }
+            data = value(field.base_type, data);
+          }
+          if (shown < count) {
+            output_->append(", ");
+            more(count - shown);
+            data = skip(message, field, data, count - shown);
+          }
+          output_->append("]\n");
+          break;
+        }
+        case CompiledField::MESSAGE_ARRAY: {
+          const CompiledMessage &element = message.subMessage(field);
+          size_t count = arrayLength(field, &data);
+          size_t shown = shownElements(count);
+          if (count == 0) {
+            output_->append(" []\n");
+            break;
+          }
+          output_->push_back('\n');
+          for (size_t j = 0; j < shown; j++) {
+            output_->append(indent + 2, ' ');
+            if (element.fields().empty()) {
+              output_->append("- {}\n");
+            } else {
+              output_->append("- ");
+              data = yamlFields(element, data, indent + 4, true);
+            }
+          }
+          if (shown < count) {
+            output_->append(indent + 2, ' ');
+            output_->append("- ");
+            more(count - shown);
+            output_->push_back('\n');
+            data = skip(message, field, data, count - shown);
+          }
+          break;
+        }
+      }
+    }
+    return data;
+  }
+
+  const uint8_t *yamlMessage(
+      const CompiledMessage &message, const uint8_t *data, size_t indent) {
+    if (message.fields().empty()) {
+      output_->append(" {}\n");
+      return data;
+    }
+    output_->push_back('\n');
+    return yamlFields(message, data, indent, false);
+  }
+
+  const uint8_t *yamlTime(
+      uint8_t base_type, const uint8_t *data, size_t indent) {
+    output_->push_back('\n');
+    output_->append(indent, ' ');
+    output_->append("sec: ");
+    timePart(base_type, data);
+    output_->push_back('\n');
+    output_->append(indent, ' ');
+    output_->append("nsec: ");
+    timePart(base_type, data + 4);
+    output_->push_back('\n');
+    return data + 8;
+  }
+
+  void timePart(uint8_t base_type, const uint8_t *data) {
+    if (base_type == BaseType::TIME) {
+      appendUnsigned(output_, read<uint32_t>(data));
+    } else {
+      appendSigned(output_, read<int32_t>(data));
+    }
+  }
+
+  // Prints a value of a base type in flow style and returns the data
+  // that follows it.
+  const uint8_t *value(uint8_t base_type, const uint8_t *data) {
+    switch (base_type) {
+      case BaseType::BOOL:
+        output_->append(data[0] ? "true" : "false");
+        return data + 1;
+      case BaseType::INT8:
+        appendSigned(output_, read<int8_t>(data));
+        return data + 1;
+      case BaseType::UINT8:
+        appendUnsigned(output_, data[0]);
+        return data + 1;
+      case BaseType::INT16:
+        appendSigned(output_, read<int16_t>(data));
+        return data + 2;
+      case BaseType::UINT16:
+        appendUnsigned(output_, read<uint16_t>(data));
+        return data + 2;
+      case BaseType::INT32:
+        appendSigned(output_, read<int32_t>(data));
+        return data + 4;
+      case BaseType::UINT32:
+        appendUnsigned(output_, read<uint32_t>(data));
+        return data + 4;
+      case BaseType::INT64:
+        appendSigned(output_, read<int64_t>(data));
+        return data + 8;
+      case BaseType::UINT64:
+        appendUnsigned(output_, read<uint64_t>(data));
+        return data + 8;
+      case BaseType::FLOAT32:
+        appendFloat(output_, read<float>(data), json_);
+        return data + 4;
+      case BaseType::FLOAT64:
+        appendFloat(output_, read<double>(data), json_);
+        return data + 8;
+      case BaseType::STRING: {
+        uint32_t length = read<uint32_t>(data);
+        appendString(output_, data + 4, length, json_);
+        return data + 4 + length;
+      }
+      case BaseType::TIME:
+      case BaseType::DURATION:
+        output_->append(json_ ? "{\"sec\":" : "{sec: ");
+        timePart(base_type, data);
+        output_->append(json_ ? ",\"nsec\":" : ", nsec: ");
+        timePart(base_type, data + 4);
+        output_->push_back('}');
+        return data + 8;
+      default:
+        return data;
+    }
+  }
+
+  void name(const CompiledMessage &message, const CompiledField &field) {
+    output_->append(
+        message.strings().str(field.name),
+        message.strings().length(field.name));
+  }
+
+  size_t shownElements(size_t count) const {
+    if (max_array_length_ && count > max_array_length_) {
+      return max_array_length_;
+    }
+    return count;
+  }
+
+  void more(size_t count) {
+    output_->append("\"... ");
+    appendUnsigned(output_, count);
+    output_->append(" more\"");
+  }
+
+  // Number of elements of an array. Skips the length prefix of arrays
+  // without a fixed length.
+  static size_t arrayLength(const CompiledField &field, const uint8_t **data) {
+    if (field.array_length != CompiledField::kUnbounded) {
+      return field.array_length;
+    }
+    uint32_t length = read<uint32_t>(*data);
+    *data += 4;
+    return length;
+  }
+
+  static const uint8_t *skip(
+      const CompiledMessage &message, const CompiledField &field,
+      const uint8_t *data, size_t count) {
+    if (!field.hasDynamicElements()) {
+      return data + count * field.element_size;
+    }
+    for (size_t i = 0; i < count; i++) {
+      if (field.sizing == CompiledField::STRINGS_SIZE) {
+        data += read<uint32_t>(data) + 4;
+      } else {
+        data += message.subMessage(field).size(data);
+      }
+    }
+    return data;
+  }
+};
+
+}  // namespace
+
+MessagePrinter::MessagePrinter(format_type format, size_t max_array_length)
+    : format_(format), max_array_length_(max_array_length) {
+}
+
+const std::string &MessagePrinter::print(
+    const CompiledMessage &message, const void *data) {
+  buffer_.clear();
+  print(message, data, &buffer_);
+  return buffer_;
+}
+
+void MessagePrinter::print(
+    const CompiledMessage &message, const void *data,
+    std::string *output) const {
+  Writer writer(output, format_ == JSON, max_array_length_);
+  writer.message(message, reinterpret_cast<const uint8_t *>(data));
+}
+
+}  // namespace generic_message
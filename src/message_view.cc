@@ -0,0 +1,92 @@
+/**
+ * Copyright (c) 2013, Lorenz Moesenlechner <moesenle@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The names of the contributors may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <generic_message/message_view.h>
+
+#include <algorithm>
+
+namespace generic_message {
+
+MessageView::MessageView(const CompiledMessage &message, const void *data)
+    : message_(&message), data_(reinterpret_cast<const uint8_t *>(data)),
+      known_(1), offsets_(inline_offsets_) {
+  offsets_[0] = 0;
+}
+
+MessageView::MessageView(const MessageView &other) {
+  assign(other);
+}
+
+MessageView &MessageView::operator=(const MessageView &other) {
+  if (this != &other) {
+    assign(other);
+  }
+  return *this;
+}
+
+void MessageView::reset(const CompiledMessage &message, const void *data) {
+  message_ = &message;
+  data_ = reinterpret_cast<const uint8_t *>(data);
+  known_ = 1;
+  offsets_ = inline_offsets_;
+  offsets_[0] = 0;
+}
+
+size_t MessageView::walk(size_t field_index) const {
+  reserve(field_index + 1);
+  while (known_ <= field_index) {
+    size_t previous = offsets_[known_ - 1];
+    offsets_[known_] =
+        previous + message_->fieldSize(known_ - 1, data_ + previous);
+    known_++;
+  }
+  return offsets_[field_index];
+}
+
+void MessageView::reserve(size_t count) const {
+  if (count <= kInlineOffsets || offsets_ != inline_offsets_) {
+    return;
+  }
+  // Make room for all fields at once so that a view allocates at most once.
+  heap_offsets_.resize(message_->fields().size() + 1);
+  std::copy(inline_offsets_, inline_offsets_ + known_, heap_offsets_.begin());
+  offsets_ = &heap_offsets_[0];
+}
+
+void MessageView::assign(const MessageView &other) {
+  message_ = other.message_;
+  data_ = other.data_;
+  known_ = 0;
+  offsets_ = inline_offsets_;
+  reserve(other.known_);
+  std::copy(other.offsets_, other.offsets_ + other.known_, offsets_);
+  known_ = other.known_;
+}
+
+}  // namespace generic_message
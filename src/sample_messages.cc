@@ -0,0 +1,271 @@
+/**
+ * Copyright (c) 2013, Lorenz Moesenlechner <moesenle@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The names of the contributors may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "sample_messages.h"
+
+#include <boost/foreach.hpp>
+#include <boost/variant/static_visitor.hpp>
+
+namespace generic_message {
+
+// All message types are fully qualified so that the parsed definitions
+// can be added to a pool without package fix-ups.
+const Definition kDefinitions[] = {
+  {"std_msgs", "Header",
+   "uint32 seq\n"
+   "time stamp\n"
+   "string frame_id\n"},
+  {"geometry_msgs", "Point",
+   "float64 x\nfloat64 y\nfloat64 z\n"},
+  {"geometry_msgs", "Vector3",
+   "float64 x\nfloat64 y\nfloat64 z\n"},
+  {"geometry_msgs", "Quaternion",
+   "float64 x\nfloat64 y\nfloat64 z\nfloat64 w\n"},
+  {"geometry_msgs", "Pose",
+   "geometry_msgs/Point position\n"
+   "geometry_msgs/Quaternion orientation\n"},
+  {"geometry_msgs", "PoseWithCovariance",
+   "geometry_msgs/Pose pose\n"
+   "float64[36] covariance\n"},
+  {"geometry_msgs", "Twist",
+   "geometry_msgs/Vector3 linear\n"
+   "geometry_msgs/Vector3 angular\n"},
+  {"geometry_msgs", "TwistWithCovariance",
+   "geometry_msgs/Twist twist\n"
+   "float64[36] covariance\n"},
+  {"geometry_msgs", "Transform",
+   "geometry_msgs/Vector3 translation\n"
+   "geometry_msgs/Quaternion rotation\n"},
+  {"geometry_msgs", "TransformStamped",
+   "std_msgs/Header header\n"
+   "string child_frame_id\n"
+   "geometry_msgs/Transform transform\n"},
+  {"geometry_msgs", "PoseArray",
+   "std_msgs/Header header\n"
+   "geometry_msgs/Pose[] poses\n"},
+  {"nav_msgs", "Odometry",
+   "std_msgs/Header header\n"
+   "string child_frame_id\n"
+   "geometry_msgs/PoseWithCovariance pose\n"
+   "geometry_msgs/TwistWithCovariance twist\n"},
+  {"sensor_msgs", "Imu",
+   "std_msgs/Header header\n"
+   "geometry_msgs/Quaternion orientation\n"
+   "float64[9] orientation_covariance\n"
+   "geometry_msgs/Vector3 angular_velocity\n"
+   "float64[9] angular_velocity_covariance\n"
+   "geometry_msgs/Vector3 linear_acceleration\n"
+   "float64[9] linear_acceleration_covariance\n"},
+  {"sensor_msgs", "JointState",
+   "std_msgs/Header header\n"
+   "string[] name\n"
+   "float64[] position\n"
+   "float64[] velocity\n"
+   "float64[] effort\n"},
+  {"sensor_msgs", "PointField",
+   "uint8 INT8=1\nuint8 UINT8=2\nuint8 INT16=3\nuint8 UINT16=4\n"
+   "uint8 INT32=5\nuint8 UINT32=6\nuint8 FLOAT32=7\nuint8 FLOAT64=8\n"
+   "string name\n"
+   "uint32 offset\n"
+   "uint8 datatype\n"
+   "uint32 count\n"},
+  {"sensor_msgs", "PointCloud2",
+   "std_msgs/Header header\n"
+   "uint32 height\n"
+   "uint32 width\n"
+   "sensor_msgs/PointField[] fields\n"
+   "bool is_bigendian\n"
+   "uint32 point_step\n"
+   "uint32 row_step\n"
+   "uint8[] data\n"
+   "bool is_dense\n"},
+  {"tf2_msgs", "TFMessage",
+   "geometry_msgs/TransformStamped[] transforms\n"},
+  {"bench_msgs", "FlatFixed",
+   "# Only fixed size fields; every offset is a constant.\n"
+   "bool flag\nint8 i8\nuint8 u8\nint16 i16\nuint16 u16\n"
+   "int32 i32\nuint32 u32\nint64 i64\nuint64 u64\n"
+   "float32 f32\nfloat64 f64\ntime stamp\nduration period\n"
+   "float64[16] matrix\nint32[8] counters\n"
+   "float64 a0\nfloat64 a1\nfloat64 a2\nfloat64 a3\n"
+   "float64 a4\nfloat64 a5\nfloat64 a6\nfloat64 a7\n"},
+  {"bench_msgs", "Nested0",
+   "uint32 value\nstring label\n"},
+  {"bench_msgs", "Nested1",
+   "uint32 value\nbench_msgs/Nested0 child\nstring label\n"},
+  {"bench_msgs", "Nested2",
+   "uint32 value\nbench_msgs/Nested1 child\nstring label\n"},
+  {"bench_msgs", "Nested3",
+   "uint32 value\nbench_msgs/Nested2 child\nstring label\n"},
+  {"bench_msgs", "Nested4",
+   "uint32 value\nbench_msgs/Nested3 child\nstring label\n"},
+  {"bench_msgs", "Nested5",
+   "uint32 value\nbench_msgs/Nested4 child\nstring label\n"},
+  {"bench_msgs", "StringHeavy",
+   "string s0\nstring s1\nstring s2\nstring s3\n"
+   "string s4\nstring s5\nstring s6\nstring s7\n"
+   "uint32 count\n"
+   "string[] tags\n"},
+};
+
+const size_t kDefinitionCount = sizeof(kDefinitions) / sizeof(kDefinitions[0]);
+
+const Sample kSamples[] = {
+  {"flat_fixed", "bench_msgs", "FlatFixed", 0, 0, 0, "a7"},
+  {"deep_nested", "bench_msgs", "Nested5", 16, 0, 0,
+   "child.child.child.child.child.label"},
+  {"string_heavy", "bench_msgs", "StringHeavy", 32, 16, 0, "tags[8]"},
+  {"imu", "sensor_msgs", "Imu", 8, 0, 0, "linear_acceleration.z"},
+  {"odometry", "nav_msgs", "Odometry", 8, 0, 0, "twist.twist.angular.z"},
+  {"joint_state", "sensor_msgs", "JointState", 12, 12, 0, "effort[6]"},
+  {"pose_array_1k", "geometry_msgs", "PoseArray", 8, 1000, 0,
+   "poses[999].orientation.w"},
+  {"tf_message_32", "tf2_msgs", "TFMessage", 12, 32, 0,
+   "transforms[31].transform.rotation.w"},
+  {"point_cloud2_64k", "sensor_msgs", "PointCloud2", 8, 4, 65536, "is_dense"},
+};
+
+const size_t kSampleCount = sizeof(kSamples) / sizeof(kSamples[0]);
+
+namespace {
+
+class BufferGenerator : public boost::static_visitor<> {
+ public:
+  BufferGenerator(
+      const MessagePool &pool, const Sample &sample, std::vector<uint8_t> *buffer)
+      : pool_(pool), sample_(sample), buffer_(buffer), state_(0x2545f491) {}
+
+  void message(const std::string &package, const std::string &name) {
+    BOOST_FOREACH(const Field &field, pool_.get(package, name).message().fields) {
+      boost::apply_visitor(*this, field.type);
+    }
+  }
+
+  void operator()(const BaseType &type) {
+    switch (type.type) {
+      case BaseType::BOOL:
+      case BaseType::INT8:
+      case BaseType::UINT8: bytes(1); break;
+      case BaseType::INT16:
+      case BaseType::UINT16: bytes(2); break;
+      case BaseType::INT32:
+      case BaseType::UINT32:
+      case BaseType::FLOAT32: bytes(4); break;
+      case BaseType::INT64:
+      case BaseType::UINT64:
+      case BaseType::FLOAT64:
+      case BaseType::TIME:
+      case BaseType::DURATION: bytes(8); break;
+      case BaseType::STRING:
+        length(sample_.string_length);
+        bytes(sample_.string_length);
+        break;
+      default:
+        break;
+    }
+  }
+
+  void operator()(const MessageType &type) {
+    message(type.package, type.name);
+  }
+
+  void operator()(const BaseTypeArray &type) {
+    bool is_blob = type.type.type == BaseType::UINT8 ||
+        type.type.type == BaseType::INT8;
+    size_t size = arraySize(type.size, is_blob);
+    for (size_t i = 0; i < size; i++) {
+      (*this)(type.type);
+    }
+  }
+
+  void operator()(const MessageTypeArray &type) {
+    size_t size = arraySize(type.size, false);
+    for (size_t i = 0; i < size; i++) {
+      message(type.type.package, type.type.name);
+    }
+  }
+
+ private:
+  const MessagePool &pool_;
+  const Sample &sample_;
+  std::vector<uint8_t> *buffer_;
+  uint32_t state_;
+
+  size_t arraySize(const boost::optional<size_t> &size, bool is_blob) {
+    if (size) {
+      return *size;
+    }
+    size_t length = is_blob ? sample_.blob_length : sample_.array_length;
+    this->length(length);
+    return length;
+  }
+
+  void length(size_t length) {
+    uint32_t value = length;
+    const uint8_t *begin = reinterpret_cast<const uint8_t *>(&value);
+    buffer_->insert(buffer_->end(), begin, begin + sizeof(value));
+  }
+
+  void bytes(size_t count) {
+    for (size_t i = 0; i < count; i++) {
+      // xorshift32, deterministic so that runs are comparable.
+      state_ ^= state_ << 13;
+      state_ ^= state_ >> 17;
+      state_ ^= state_ << 5;
+      buffer_->push_back(static_cast<uint8_t>(state_));
+    }
+  }
+};
+
+}  // namespace
+
+void addDefinitions(MessagePool *pool) {
+  for (size_t i = 0; i < kDefinitionCount; i++) {
+    pool->add(
+        kDefinitions[i].package, kDefinitions[i].name, kDefinitions[i].text);
+  }
+}
+
+const Definition &findDefinition(
+    const std::string &package, const std::string &name) {
+  for (size_t i = 0; i < kDefinitionCount; i++) {
+    if (package == kDefinitions[i].package && name == kDefinitions[i].name) {
+      return kDefinitions[i];
+    }
+  }
+  throw MessageNotFound(package + "/" + name);
+}
+
+void generateBuffer(
+    const MessagePool &pool, const Sample &sample, std::vector<uint8_t> *buffer) {
+  BufferGenerator generator(pool, sample, buffer);
+  generator.message(sample.package, sample.name);
+}
+
+}  // namespace generic_message
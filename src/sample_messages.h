@@ -0,0 +1,78 @@
+/**
+ * Copyright (c) 2013, Lorenz Moesenlechner <moesenle@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The names of the contributors may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include <generic_message/message_pool.h>
+
+// Message definitions and synthetic buffers shared by the benchmarks and
+// the unit tests.
+namespace generic_message {
+
+struct Definition {
+  const char *package;
+  const char *name;
+  const char *text;
+};
+
+extern const Definition kDefinitions[];
+extern const size_t kDefinitionCount;
+
+// A synthetic buffer for one schema. Dynamic sizes are chosen per sample
+// so that the same schema can be measured with small and large payloads.
+struct Sample {
+  const char *label;
+  const char *package;
+  const char *name;
+  size_t string_length;
+  size_t array_length;
+  size_t blob_length;
+  // Nested field path that is resolved by the field_path benchmarks.
+  const char *path;
+};
+
+
+extern const Sample kSamples[];
+extern const size_t kSampleCount;
+
+void addDefinitions(MessagePool *pool);
+// Throws MessageNotFound if there is no definition of the message.
+const Definition &findDefinition(
+    const std::string &package, const std::string &name);
+// Appends a buffer of the sample's message with deterministic random
+// contents to buffer.
+void generateBuffer(
+    const MessagePool &pool, const Sample &sample, std::vector<uint8_t> *buffer);
+
+}  // namespace generic_message
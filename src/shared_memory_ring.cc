@@ -0,0 +1,384 @@
+/**
+ * Copyright (c) 2013, Lorenz Moesenlechner <moesenle@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The names of the contributors may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <generic_message/shared_memory_ring.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <limits>
+
+#include <boost/atomic.hpp>
+#include <boost/static_assert.hpp>
+
+#if BOOST_ATOMIC_INT64_LOCK_FREE != 2
+#error "Shared memory rings need lock-free 64 bit atomics"
+#endif
+
+namespace generic_message {
+
+namespace {
+
+// "GMRING01" on little endian machines.
+const uint64_t kMagic = 0x3130474e49524d47ull;
+const uint32_t kVersion = 1;
+const size_t kCacheLine = 64;
+const size_t kHeaderSize = 4 * kCacheLine;
+// Larger slots would overflow the slot stride.
+const size_t kMaxSlotSize = std::numeric_limits<size_t>::max() - 2 * kCacheLine;
+
+struct RingHeader {
+  // Written last by the writer once the header is complete.
+  boost::atomic<uint64_t> magic;
+  uint32_t version;
+  uint32_t reserved;
+  uint64_t slot_count;
+  uint64_t slot_size;
+  uint64_t slot_stride;
+  char fingerprint[32];
+  // Type name for error messages, truncated if necessary.
+  char type[120];
+  // Number of published messages, on a cache line of its own.
+  boost::atomic<uint64_t> head;
+};
+
+BOOST_STATIC_ASSERT(sizeof(RingHeader) <= kHeaderSize);
+
+// Precedes the data of every slot, which starts on the next cache line.
+struct SlotHeader {
+  // 2 * n + 1 while message n is written, 2 * n + 2 once it is published.
+  boost::atomic<uint64_t> sequence;
+  uint64_t size;
+};
+
+size_t slotStride(size_t slot_size) {
+  return kCacheLine + (slot_size + kCacheLine - 1) / kCacheLine * kCacheLine;
+}
+
+// Size of the shared memory of a ring. Throws RingError if the ring is
+// empty or does not fit into the address space.
+size_t ringSize(size_t slot_count, size_t slot_size) {
+  if (slot_count == 0 || slot_size == 0) {
+    throw RingError("A ring needs at least one slot of at least one byte");
+  }
+  if (slot_size > kMaxSlotSize ||
+      slot_count > (std::numeric_limits<size_t>::max() - kHeaderSize) /
+          slotStride(slot_size)) {
+    throw RingError("Ring is too large");
+  }
+  return kHeaderSize + slot_count * slotStride(slot_size);
+}
+
+RingHeader *header(const SharedMemory &memory) {
+  return reinterpret_cast<RingHeader *>(memory.data());
+}
+
+SlotHeader *slot(
+    const SharedMemory &memory, size_t stride, size_t slot_count,
+    uint64_t sequence) {
+  return reinterpret_cast<SlotHeader *>(
+      memory.data() + kHeaderSize + (sequence % slot_count) * stride);
+}
+
+std::string systemError(const std::string &message) {
+  return message + ": " + strerror(errno);
+}
+
+std::string typeName(const CompiledMessage &message) {
+  MessageType type = message.type();
+  return type.package + "/" + type.name;
+}
+
+}  // namespace
+
+SharedMemory::SharedMemory(const std::string &name, size_t size)
+    : name_(name), fd_(-1), data_(0), size_(size), owner_(true) {
+  if (name_.empty()) {
+#ifdef MFD_CLOEXEC
+    fd_ = memfd_create("generic_message", MFD_CLOEXEC);
+#else
+    errno = ENOSYS;
+#endif
+  } else {
+    fd_ = shm_open(name_.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  }
+  if (fd_ < 0 && errno == EEXIST) {
+    // Another writer may still be using it, so it is only removed on
+    // request.
+    throw RingError(
+        "Shared memory " + name_ + " already exists, remove it with "
+        "SharedMemory::remove if it is stale");
+  }
+  if (fd_ < 0) {
+    throw RingError(systemError("Unable to create shared memory " + name_));
+  }
+  if (ftruncate(fd_, size_) != 0) {
+    std::string error = systemError("Unable to resize shared memory " + name_);
+    close(fd_);
+    if (!name_.empty()) {
+      shm_unlink(name_.c_str());
+    }
+    throw RingError(error);
+  }
+  map(true);
+}
+
+SharedMemory::SharedMemory(const std::string &name)
+    : name_(name), fd_(-1), data_(0), size_(0), owner_(false) {
+  fd_ = shm_open(name_.c_str(), O_RDONLY, 0);
+  if (fd_ < 0) {
+    throw RingError(systemError("Unable to open shared memory " + name_));
+  }
+  map(false);
+}
+
+SharedMemory::SharedMemory(int fd)
+    : fd_(-1), data_(0), size_(0), owner_(false) {
+  fd_ = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+  if (fd_ < 0) {
+    throw RingError(systemError("Unable to duplicate file descriptor"));
+  }
+  map(false);
+}
+
+SharedMemory::~SharedMemory() {
+  munmap(data_, size_);
+  close(fd_);
+  if (owner_ && !name_.empty()) {
+    shm_unlink(name_.c_str());
+  }
+}
+
+bool SharedMemory::remove(const std::string &name) {
+  if (shm_unlink(name.c_str()) == 0) {
+    return true;
+  }
+  if (errno == ENOENT) {
+    return false;
+  }
+  throw RingError(systemError("Unable to remove shared memory " + name));
+}
+
+void SharedMemory::map(bool writable) {
+  if (!writable) {
+    struct stat status;
+    if (fstat(fd_, &status) != 0) {
+      std::string error = systemError("Unable to stat shared memory " + name_);
+      close(fd_);
+      throw RingError(error);
+    }
+    size_ = status.st_size;
+  }
+  void *data = mmap(
+      0, size_, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED,
+      fd_, 0);
+  if (data == MAP_FAILED) {
+    std::string error = systemError("Unable to map shared memory " + name_);
+    close(fd_);
+    if (owner_ && !name_.empty()) {
+      shm_unlink(name_.c_str());
+    }
+    throw RingError(error);
+  }
+  data_ = reinterpret_cast<uint8_t *>(data);
+}
+
+RingWriter::RingWriter(
+    const std::string &name, const CompiledMessage &message,
+    size_t slot_count, size_t slot_size)
+    : memory_(name, ringSize(slot_count, slot_size)),
+      slot_count_(slot_count), slot_size_(slot_size), sequence_(0),
+      reserved_(false), reserved_size_(0) {
+  // New shared memory is zero filled, so the copied names do not need to
+  // be terminated.
+  RingHeader *ring = header(memory_);
+  ring->version = kVersion;
+  ring->slot_count = slot_count;
+  ring->slot_size = slot_size;
+  ring->slot_stride = slotStride(slot_size);
+  std::string fingerprint = message.fingerprint();
+  memcpy(ring->fingerprint, fingerprint.data(),
+         std::min(fingerprint.size(), sizeof(ring->fingerprint)));
+  std::string type = typeName(message);
+  memcpy(ring->type, type.data(),
+         std::min(type.size(), sizeof(ring->type) - 1));
+  ring->magic.store(kMagic, boost::memory_order_release);
+}
+
+void *RingWriter::reserve(size_t size) {
+  if (size > slot_size_) {
+    throw RingError("Message does not fit into a ring slot");
+  }
+  SlotHeader *current = slot(
+      memory_, slotStride(slot_size_), slot_count_, sequence_);
+  if (!reserved_) {
+    // Readers that already hold the slot's previous message see the odd
+    // sequence and know that it is being overwritten.
+    current->sequence.store(2 * sequence_ + 1, boost::memory_order_relaxed);
+    boost::atomic_thread_fence(boost::memory_order_release);
+    reserved_ = true;
+  }
+  reserved_size_ = size;
+  return reinterpret_cast<uint8_t *>(current) + kCacheLine;
+}
+
+void RingWriter::commit() {
+  if (!reserved_) {
+    throw RingError("No message was reserved");
+  }
+  SlotHeader *current = slot(
+      memory_, slotStride(slot_size_), slot_count_, sequence_);
+  current->size = reserved_size_;
+  current->sequence.store(2 * sequence_ + 2, boost::memory_order_release);
+  sequence_++;
+  header(memory_)->head.store(sequence_, boost::memory_order_release);
+  reserved_ = false;
+}
+
+void RingWriter::write(const void *data, size_t size) {
+  memcpy(reserve(size), data, size);
+  commit();
+}
+
+RingReader::RingReader(const std::string &name, const CompiledMessage &message)
+    : message_(&message), memory_(name), slot_count_(0), slot_size_(0),
+      next_(0), dropped_(0) {
+  attach();
+}
+
+RingReader::RingReader(int fd, const CompiledMessage &message)
+    : message_(&message), memory_(fd), slot_count_(0), slot_size_(0),
+      next_(0), dropped_(0) {
+  attach();
+}
+
+bool RingReader::read(RingMessage *message) {
+  uint64_t head = header(memory_)->head.load(boost::memory_order_acquire);
+  if (head - next_ > slot_count_) {
+    dropped_ += head - slot_count_ - next_;
+    next_ = head - slot_count_;
+  }
+  size_t stride = slotStride(slot_size_);
+  for (; next_ < head; next_++) {
+    const SlotHeader *current = slot(memory_, stride, slot_count_, next_);
+    uint64_t sequence = current->sequence.load(boost::memory_order_acquire);
+    size_t size = current->size;
+    message->data = reinterpret_cast<const uint8_t *>(current) + kCacheLine;
+    message->size = size;
+    message->sequence = next_;
+    if (sequence != 2 * next_ + 2 || size > slot_size_) {
+      dropped_++;
+      continue;
+    }
+    // A message that fails validation may just have been overwritten
+    // while it was checked.
+    size_t message_size;
+    try {
+      message_size = message_->checkedSize(message->data, size);
+    } catch (const InvalidMessage &) {
+      if (!isCurrent(*message)) {
+        dropped_++;
+        continue;
+      }
+      throw;
+    }
+    if (message_size != size) {
+      if (!isCurrent(*message)) {
+        dropped_++;
+        continue;
+      }
+      throw InvalidMessage("Message is smaller than its ring slot");
+    }
+    next_++;
+    return true;
+  }
+  return false;
+}
+
+bool RingReader::read(std::vector<uint8_t> *data, uint64_t *sequence) {
+  RingMessage message;
+  while (read(&message)) {
+    const uint8_t *begin = reinterpret_cast<const uint8_t *>(message.data);
+    data->assign(begin, begin + message.size);
+    // The copy matches the validated message unless the writer reused
+    // the slot in the meantime.
+    if (isCurrent(message)) {
+      if (sequence) {
+        *sequence = message.sequence;
+      }
+      return true;
+    }
+    dropped_++;
+  }
+  return false;
+}
+
+bool RingReader::isCurrent(const RingMessage &message) const {
+  boost::atomic_thread_fence(boost::memory_order_acquire);
+  const SlotHeader *current = slot(
+      memory_, slotStride(slot_size_), slot_count_, message.sequence);
+  return current->sequence.load(boost::memory_order_relaxed) ==
+      2 * message.sequence + 2;
+}
+
+void RingReader::attach() {
+  if (memory_.size() < kHeaderSize) {
+    throw RingError("Shared memory is too small for a ring");
+  }
+  const RingHeader *ring = header(memory_);
+  if (ring->magic.load(boost::memory_order_acquire) != kMagic ||
+      ring->version != kVersion) {
+    throw RingError("Shared memory does not contain a ring");
+  }
+  if (ring->slot_count == 0 || ring->slot_size == 0 ||
+      ring->slot_size > kMaxSlotSize ||
+      ring->slot_stride != slotStride(ring->slot_size) ||
+      ring->slot_count > (memory_.size() - kHeaderSize) / ring->slot_stride) {
+    throw RingError("Ring header is corrupted");
+  }
+  std::string fingerprint(
+      ring->fingerprint,
+      strnlen(ring->fingerprint, sizeof(ring->fingerprint)));
+  if (fingerprint != message_->fingerprint()) {
+    throw RingError(
+        "Ring carries " +
+        std::string(ring->type, strnlen(ring->type, sizeof(ring->type))) +
+        " but the reader expects " + typeName(*message_));
+  }
+  slot_count_ = ring->slot_count;
+  slot_size_ = ring->slot_size;
+  next_ = ring->head.load(boost::memory_order_acquire);
+}
+
+}  // namespace generic_message
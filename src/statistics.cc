@@ -0,0 +1,252 @@
+/**
+ * Copyright (c) 2013, Lorenz Moesenlechner <moesenle@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The names of the contributors may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <generic_message/statistics.h>
+
+#include <pthread.h>
+#include <time.h>
+
+#include <set>
+#include <utility>
+#include <vector>
+
+#include <boost/foreach.hpp>
+#include <boost/thread/locks.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace generic_message {
+
+namespace statistics {
+
+__thread ThreadCounters *thread_counters = 0;
+
+namespace {
+
+const size_t kMaxCounters = kChunkSize * kMaxChunks;
+
+// Counters of kinds that are not global go to an overflow counter named
+// "<other>" once the registry is full. Room for these is kept free.
+const size_t kReservedCounters = 3;
+
+struct CounterInfo {
+  counter_kind kind;
+  std::string name;
+
+  CounterInfo(counter_kind kind, const std::string &name)
+      : kind(kind), name(name) {}
+};
+
+struct Registry {
+  boost::mutex mutex;
+  std::vector<CounterInfo> counters;
+  std::map<std::pair<counter_kind, std::string>, size_t> ids;
+  std::set<ThreadCounters *> threads;
+  // Counts of threads that already exited.
+  std::vector<uint64_t> retired;
+  // Totals at the time of the last reset.
+  std::vector<uint64_t> baseline;
+  pthread_key_t thread_key;
+
+  Registry();
+};
+
+void destroyThreadCounters(void *data);
+
+Registry::Registry() {
+  // Global counters are registered first so that their ids are equal to
+  // their kind.
+  counter_kind global_kinds[] = {
+    POOL_GET_CALLS, POOL_GET_MISSES, DYNAMIC_OFFSET_EVALUATIONS, BYTES_WALKED};
+  BOOST_FOREACH(counter_kind kind, global_kinds) {
+    ids[std::make_pair(kind, std::string())] = counters.size();
+    counters.push_back(CounterInfo(kind, std::string()));
+  }
+  pthread_key_create(&thread_key, &destroyThreadCounters);
+}
+
+// The registry is intentionally leaked so that threads exiting during
+// static destruction can still fold their counts into it.
+Registry &registry() {
+  static Registry *instance = new Registry();
+  return *instance;
+}
+
+void accumulate(const ThreadCounters &counters, std::vector<uint64_t> *totals) {
+  for (size_t i = 0; i < kMaxChunks; i++) {
+    const Chunk *chunk = counters.chunks[i].load(boost::memory_order_acquire);
+    if (!chunk) {
+      continue;
+    }
+    for (size_t j = 0; j < kChunkSize && i * kChunkSize + j < totals->size(); j++) {
+      (*totals)[i * kChunkSize + j] +=
+          chunk->values[j].load(boost::memory_order_relaxed);
+    }
+  }
+}
+
+void destroyThreadCounters(void *data) {
+  ThreadCounters *counters = reinterpret_cast<ThreadCounters *>(data);
+  Registry &instance = registry();
+  {
+    boost::lock_guard<boost::mutex> lock(instance.mutex);
+    instance.retired.resize(instance.counters.size());
+    accumulate(*counters, &instance.retired);
+    instance.threads.erase(counters);
+  }
+  thread_counters = 0;
+  delete counters;
+}
+
+// Must be called with the registry mutex held.
+std::vector<uint64_t> totals(const Registry &instance) {
+  std::vector<uint64_t> result(instance.retired);
+  result.resize(instance.counters.size());
+  BOOST_FOREACH(const ThreadCounters *counters, instance.threads) {
+    accumulate(*counters, &result);
+  }
+  return result;
+}
+
+}  // namespace
+
+Chunk::Chunk() {
+  for (size_t i = 0; i < kChunkSize; i++) {
+    values[i].store(0, boost::memory_order_relaxed);
+  }
+}
+
+ThreadCounters::ThreadCounters() {
+  for (size_t i = 0; i < kMaxChunks; i++) {
+    chunks[i].store(0, boost::memory_order_relaxed);
+  }
+}
+
+ThreadCounters::~ThreadCounters() {
+  for (size_t i = 0; i < kMaxChunks; i++) {
+    delete chunks[i].load(boost::memory_order_relaxed);
+  }
+}
+
+size_t registerCounter(counter_kind kind, const std::string &name) {
+  Registry &instance = registry();
+  boost::lock_guard<boost::mutex> lock(instance.mutex);
+  std::pair<counter_kind, std::string> key(kind, name);
+  std::map<std::pair<counter_kind, std::string>, size_t>::const_iterator it =
+      instance.ids.find(key);
+  if (it != instance.ids.end()) {
+    return it->second;
+  }
+  if (instance.counters.size() + kReservedCounters >= kMaxCounters) {
+    key.second = "<other>";
+    it = instance.ids.find(key);
+    if (it != instance.ids.end()) {
+      return it->second;
+    }
+  }
+  size_t id = instance.counters.size();
+  instance.ids[key] = id;
+  instance.counters.push_back(CounterInfo(kind, key.second));
+  return id;
+}
+
+ThreadCounters *initializeThread() {
+  Registry &instance = registry();
+  ThreadCounters *counters = new ThreadCounters();
+  {
+    boost::lock_guard<boost::mutex> lock(instance.mutex);
+    instance.threads.insert(counters);
+  }
+  pthread_setspecific(instance.thread_key, counters);
+  thread_counters = counters;
+  return counters;
+}
+
+Chunk *allocateChunk(ThreadCounters *counters, size_t index) {
+  Chunk *chunk = new Chunk();
+  counters->chunks[index].store(chunk, boost::memory_order_release);
+  return chunk;
+}
+
+uint64_t now() {
+  timespec time;
+  clock_gettime(CLOCK_MONOTONIC, &time);
+  return static_cast<uint64_t>(time.tv_sec) * 1000000000 + time.tv_nsec;
+}
+
+}  // namespace statistics
+
+bool statisticsEnabled() {
+#ifdef GENERIC_MESSAGE_ENABLE_STATISTICS
+  return true;
+#else
+  return false;
+#endif
+}
+
+Statistics statisticsSnapshot() {
+  using namespace statistics;
+
+  Registry &instance = registry();
+  boost::lock_guard<boost::mutex> lock(instance.mutex);
+  std::vector<uint64_t> values = totals(instance);
+  Statistics result;
+  for (size_t i = 0; i < values.size(); i++) {
+    uint64_t value = values[i];
+    if (i < instance.baseline.size()) {
+      value -= instance.baseline[i];
+    }
+    const CounterInfo &info = instance.counters[i];
+    switch (info.kind) {
+      case POOL_GET_CALLS: result.pool_get_calls = value; break;
+      case POOL_GET_MISSES: result.pool_get_misses = value; break;
+      case DYNAMIC_OFFSET_EVALUATIONS:
+        result.dynamic_offset_evaluations = value;
+        break;
+      case BYTES_WALKED: result.bytes_walked = value; break;
+      case FIELD_DYNAMIC_OFFSET_EVALUATIONS:
+        result.dynamic_offset_evaluations_by_field[info.name] += value;
+        break;
+      case TYPE_COMPILATIONS:
+        result.compilations[info.name] += value;
+        break;
+      case TYPE_COMPILE_TIME_NS:
+        result.compile_time_ns[info.name] += value;
+        break;
+    }
+  }
+  return result;
+}
+
+void resetStatistics() {
+  statistics::Registry &instance = statistics::registry();
+  boost::lock_guard<boost::mutex> lock(instance.mutex);
+  instance.baseline = statistics::totals(instance);
+}
+
+}  // namespace generic_message
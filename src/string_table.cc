@@ -0,0 +1,168 @@
+/**
+ * Copyright (c) 2013, Lorenz Moesenlechner <moesenle@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The names of the contributors may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <generic_message/string_table.h>
+
+#include <string.h>
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace generic_message {
+
+const uint32_t StringTable::kNotFound;
+
+static uint32_t hashString(const char *data, size_t length) {
+  // FNV-1a.
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < length; i++) {
+    hash ^= static_cast<uint8_t>(data[i]);
+    hash *= 16777619u;
+  }
+  return hash;
+}
+
+StringTable::StringTable()
+    : count_(0), block_used_(kBlockSize), character_bytes_(0),
+      index_(64, kNotFound) {
+  for (size_t i = 0; i < kSegments; i++) {
+    segments_[i] = 0;
+  }
+}
+
+StringTable::~StringTable() {
+  for (size_t i = 0; i < kSegments; i++) {
+    delete[] segments_[i];
+  }
+  for (size_t i = 0; i < blocks_.size(); i++) {
+    delete[] blocks_[i];
+  }
+}
+
+uint32_t StringTable::intern(const std::string &value) {
+  uint32_t id = find(value);
+  if (id != kNotFound) {
+    return id;
+  }
+  if (count_ == kNotFound) {
+    throw std::length_error("String table is full");
+  }
+  id = count_;
+  uint32_t position = id / kFirstSegment + 1;
+  uint32_t segment = 31 - __builtin_clz(position);
+  if (!segments_[segment]) {
+    segments_[segment] = new Entry[kFirstSegment << segment];
+  }
+  Entry &new_entry = entry(id);
+  new_entry.data = store(value);
+  new_entry.length = value.size();
+  new_entry.hash = hashString(value.data(), value.size());
+  count_++;
+  if (2 * count_ > index_.size()) {
+    grow();
+  } else {
+    size_t mask = index_.size() - 1;
+    size_t slot = new_entry.hash & mask;
+    while (index_[slot] != kNotFound) {
+      slot = (slot + 1) & mask;
+    }
+    index_[slot] = id;
+  }
+  return id;
+}
+
+uint32_t StringTable::find(const std::string &value) const {
+  uint32_t hash = hashString(value.data(), value.size());
+  size_t mask = index_.size() - 1;
+  for (size_t slot = hash & mask; index_[slot] != kNotFound;
+       slot = (slot + 1) & mask) {
+    const Entry &candidate = entry(index_[slot]);
+    if (candidate.hash == hash && candidate.length == value.size() &&
+        memcmp(candidate.data, value.data(), value.size()) == 0) {
+      return index_[slot];
+    }
+  }
+  return kNotFound;
+}
+
+bool StringTable::equals(uint32_t id, const std::string &value) const {
+  const Entry &candidate = entry(id);
+  return candidate.length == value.size() &&
+      memcmp(candidate.data, value.data(), value.size()) == 0;
+}
+
+size_t StringTable::memoryUsage() const {
+  size_t entries = 0;
+  for (size_t i = 0; i < kSegments; i++) {
+    if (segments_[i]) {
+      entries += kFirstSegment << i;
+    }
+  }
+  return sizeof(*this) + character_bytes_ +
+      blocks_.capacity() * sizeof(char *) + entries * sizeof(Entry) +
+      index_.capacity() * sizeof(uint32_t);
+}
+
+const char *StringTable::store(const std::string &value) {
+  size_t size = value.size() + 1;
+  char *data;
+  if (size > kBlockSize / 4) {
+    // Large strings get a block of their own so that they do not waste
+    // the rest of the current block.
+    data = new char[size];
+    blocks_.push_back(data);
+    character_bytes_ += size;
+  } else {
+    if (block_used_ + size > kBlockSize) {
+      blocks_.push_back(new char[kBlockSize]);
+      block_used_ = 0;
+      character_bytes_ += kBlockSize;
+      std::swap(blocks_.back(), blocks_.front());
+    }
+    data = blocks_.front() + block_used_;
+    block_used_ += size;
+  }
+  memcpy(data, value.c_str(), size);
+  return data;
+}
+
+void StringTable::grow() {
+  std::vector<uint32_t> index(index_.size() * 2, kNotFound);
+  size_t mask = index.size() - 1;
+  for (uint32_t id = 0; id < count_; id++) {
+    size_t slot = entry(id).hash & mask;
+    while (index[slot] != kNotFound) {
+      slot = (slot + 1) & mask;
+    }
+    index[slot] = id;
+  }
+  index_.swap(index);
+}
+
+}  // namespace generic_message
@@ -0,0 +1,426 @@
+/**
+ * Copyright (c) 2013, Lorenz Moesenlechner <moesenle@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The names of the contributors may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <generic_message/swap_plan.h>
+
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define GENERIC_MESSAGE_X86_SWAP
+#endif
+
+namespace generic_message {
+
+namespace {
+
+typedef CompiledMessage::CompiledField CompiledField;
+
+uint32_t readLength(const uint8_t *data, bool to_native) {
+  uint32_t length;
+  memcpy(&length, data, 4);
+  return to_native ? __builtin_bswap32(length) : length;
+}
+
+void writeSwapped(uint8_t *data, uint32_t value) {
+  value = __builtin_bswap32(value);
+  memcpy(data, &value, 4);
+}
+
+template<typename T, T (*Swap)(T)>
+void swapScalars(const uint8_t *input, uint8_t *output, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    T value;
+    memcpy(&value, input + i * sizeof(T), sizeof(T));
+    value = Swap(value);
+    memcpy(output + i * sizeof(T), &value, sizeof(T));
+  }
+}
+
+uint16_t swap16(uint16_t value) {
+  return __builtin_bswap16(value);
+}
+
+uint32_t swap32(uint32_t value) {
+  return __builtin_bswap32(value);
+}
+
+uint64_t swap64(uint64_t value) {
+  return __builtin_bswap64(value);
+}
+
+void swapScalars(
+    uint8_t width, const uint8_t *input, uint8_t *output, size_t count) {
+  switch (width) {
+    case 2: swapScalars<uint16_t, swap16>(input, output, count); break;
+    case 4: swapScalars<uint32_t, swap32>(input, output, count); break;
+    case 8: swapScalars<uint64_t, swap64>(input, output, count); break;
+  }
+}
+
+typedef void (*SwapFunction)(
+    uint8_t width, const uint8_t *input, uint8_t *output, size_t count);
+
+#ifdef GENERIC_MESSAGE_X86_SWAP
+
+// Shuffle masks that reverse the bytes of each 2, 4 and 8 byte lane.
+const uint8_t kShuffleMasks[3][16] = {
+  {1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14},
+  {3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12},
+  {7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8},
+};
+
+const uint8_t *shuffleMask(uint8_t width) {
+  return kShuffleMasks[width == 2 ? 0 : width == 4 ? 1 : 2];
+}
+
+__attribute__((target("ssse3")))
+void swapSsse3(
+    uint8_t width, const uint8_t *input, uint8_t *output, size_t count) {
+  __m128i mask = _mm_loadu_si128(
+      reinterpret_cast<const __m128i *>(shuffleMask(width)));
+  size_t bytes = count * width;
+  size_t i = 0;
+  for (; i + 16 <= bytes; i += 16) {
+    __m128i value = _mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(input + i));
+    _mm_storeu_si128(
+        reinterpret_cast<__m128i *>(output + i),
+        _mm_shuffle_epi8(value, mask));
+  }
+  swapScalars(width, input + i, output + i, (bytes - i) / width);
+}
+
+__attribute__((target("avx2")))
+void swapAvx2(
+    uint8_t width, const uint8_t *input, uint8_t *output, size_t count) {
+  // vpshufb shuffles within 128 bit lanes, so the mask is repeated.
+  __m128i half = _mm_loadu_si128(
+      reinterpret_cast<const __m128i *>(shuffleMask(width)));
+  __m256i mask = _mm256_broadcastsi128_si256(half);
+  size_t bytes = count * width;
+  size_t i = 0;
+  for (; i + 32 <= bytes; i += 32) {
+    __m256i value = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(input + i));
+    _mm256_storeu_si256(
+        reinterpret_cast<__m256i *>(output + i),
+        _mm256_shuffle_epi8(value, mask));
+  }
+  if (i + 16 <= bytes) {
+    __m128i value = _mm_loadu_si128(
+        reinterpret_cast<const __m128i *>(input + i));
+    _mm_storeu_si128(
+        reinterpret_cast<__m128i *>(output + i),
+        _mm_shuffle_epi8(value, half));
+    i += 16;
+  }
+  swapScalars(width, input + i, output + i, (bytes - i) / width);
+}
+
+SwapFunction selectSwapFunction() {
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) {
+    return &swapAvx2;
+  } else if (__builtin_cpu_supports("ssse3")) {
+    return &swapSsse3;
+  }
+  return &swapScalars;
+}
+
+#else
+
+SwapFunction selectSwapFunction() {
+  return &swapScalars;
+}
+
+#endif
+
+// Runs shorter than this are not worth the indirect call.
+const size_t kMinVectorBytes = 32;
+
+void swapRun(
+    uint8_t width, const uint8_t *input, uint8_t *output, size_t count) {
+  static const SwapFunction swap_function = selectSwapFunction();
+  if (width == 1) {
+    if (input != output) {
+      memcpy(output, input, count);
+    }
+  } else if (count * width < kMinVectorBytes) {
+    swapScalars(width, input, output, count);
+  } else {
+    swap_function(width, input, output, count);
+  }
+}
+
+uint8_t baseTypeWidth(uint8_t base_type) {
+  switch (base_type) {
+    case BaseType::INT16:
+    case BaseType::UINT16:
+      return 2;
+    case BaseType::INT32:
+    case BaseType::UINT32:
+    case BaseType::FLOAT32:
+    case BaseType::TIME:
+    case BaseType::DURATION:
+      return 4;
+    case BaseType::INT64:
+    case BaseType::UINT64:
+    case BaseType::FLOAT64:
+      return 8;
+    default:
+      return 1;
+  }
+}
+
+// time and duration are two 32 bit integers.
+uint32_t baseTypeScalars(uint8_t base_type) {
+  return base_type == BaseType::TIME || base_type == BaseType::DURATION
+      ? 2 : 1;
+}
+
+void checkSize(size_t offset, uint64_t bytes, size_t size) {
+  if (bytes > size - offset) {
+    throw ConversionFailed("Message exceeds the buffer");
+  }
+}
+
+}  // namespace
+
+SwapPlan::SwapPlan(const CompiledMessage &message) {
+  std::map<const CompiledMessage *, uint32_t> plan_indices;
+  root_ = compile(message, &plan_indices);
+}
+
+size_t SwapPlan::apply(
+    void *data, size_t size, direction_type direction) const {
+  uint8_t *bytes = reinterpret_cast<uint8_t *>(data);
+  return run(root_, bytes, bytes, size, direction == TO_NATIVE);
+}
+
+size_t SwapPlan::apply(
+    const void *input, void *output, size_t size,
+    direction_type direction) const {
+  return run(
+      root_, reinterpret_cast<const uint8_t *>(input),
+      reinterpret_cast<uint8_t *>(output), size, direction == TO_NATIVE);
+}
+
+size_t SwapPlan::operationCount() const {
+  return operationCount(root_);
+}
+
+size_t SwapPlan::operationCount(uint32_t plan_index) const {
+  const Plan &plan = plans_[plan_index];
+  size_t count = plan.size();
+  for (size_t i = 0; i < plan.size(); i++) {
+    if (plan[i].kind == Operation::MESSAGES) {
+      count += operationCount(plan[i].plan);
+    }
+  }
+  return count;
+}
+
+uint32_t SwapPlan::compile(
+    const CompiledMessage &message,
+    std::map<const CompiledMessage *, uint32_t> *plan_indices) {
+  std::map<const CompiledMessage *, uint32_t>::const_iterator existing =
+      plan_indices->find(&message);
+  if (existing != plan_indices->end()) {
+    return existing->second;
+  }
+  Plan plan;
+  const std::vector<CompiledField> &fields = message.fields();
+  for (size_t i = 0; i < fields.size(); i++) {
+    const CompiledField &field = fields[i];
+    bool bounded = field.array_length != CompiledField::kUnbounded;
+    Operation operation = Operation();
+    operation.count = field.array_length;
+    switch (field.kind) {
+      case CompiledField::BASE:
+        if (field.base_type == BaseType::STRING) {
+          operation.kind = Operation::STRING;
+          append(&plan, operation);
+        } else {
+          appendRun(
+              &plan, baseTypeWidth(field.base_type),
+              baseTypeScalars(field.base_type));
+        }
+        break;
+      case CompiledField::MESSAGE: {
+        // Sub-messages are inlined, which merges their runs with the
+        // surrounding fields.
+        Plan sub_plan = plans_[compile(message.subMessage(field), plan_indices)];
+        for (size_t j = 0; j < sub_plan.size(); j++) {
+          append(&plan, sub_plan[j]);
+        }
+        break;
+      }
+      case CompiledField::BASE_ARRAY:
+        if (field.base_type == BaseType::STRING) {
+          operation.kind = Operation::STRINGS;
+          append(&plan, operation);
+        } else if (bounded) {
+          appendRun(
+              &plan, baseTypeWidth(field.base_type),
+              static_cast<uint64_t>(field.array_length) *
+                  baseTypeScalars(field.base_type));
+        } else {
+          operation.kind = Operation::PREFIXED_RUN;
+          operation.width = baseTypeWidth(field.base_type);
+          operation.count = baseTypeScalars(field.base_type);
+          append(&plan, operation);
+        }
+        break;
+      case CompiledField::MESSAGE_ARRAY: {
+        uint32_t element = compile(message.subMessage(field), plan_indices);
+        const Plan &element_plan = plans_[element];
+        // Elements that are a single run are merged into one run.
+        if (element_plan.size() <= 1 &&
+            (element_plan.empty() || element_plan[0].kind == Operation::RUN)) {
+          uint8_t width = element_plan.empty() ? 1 : element_plan[0].width;
+          uint32_t count = element_plan.empty() ? 0 : element_plan[0].count;
+          if (bounded) {
+            appendRun(
+                &plan, width, static_cast<uint64_t>(field.array_length) * count);
+          } else {
+            operation.kind = Operation::PREFIXED_RUN;
+            operation.width = width;
+            operation.count = count;
+            append(&plan, operation);
+          }
+        } else {
+          operation.kind = Operation::MESSAGES;
+          operation.plan = element;
+          append(&plan, operation);
+        }
+        break;
+      }
+    }
+  }
+  uint32_t index = plans_.size();
+  plans_.push_back(plan);
+  (*plan_indices)[&message] = index;
+  return index;
+}
+
+void SwapPlan::appendRun(Plan *plan, uint8_t width, uint64_t count) {
+  while (count > 0) {
+    Operation operation = Operation();
+    operation.kind = Operation::RUN;
+    operation.width = width;
+    operation.count = count > 0xffffffffu ? 0xffffffffu : count;
+    append(plan, operation);
+    count -= operation.count;
+  }
+}
+
+void SwapPlan::append(Plan *plan, const Operation &operation) {
+  if (operation.kind == Operation::RUN && !plan->empty()) {
+    Operation &last = plan->back();
+    if (last.kind == Operation::RUN && last.width == operation.width &&
+        static_cast<uint64_t>(last.count) + operation.count <= 0xffffffffu) {
+      last.count += operation.count;
+      return;
+    }
+  }
+  if (operation.kind == Operation::RUN && operation.count == 0) {
+    return;
+  }
+  plan->push_back(operation);
+}
+
+size_t SwapPlan::run(
+    uint32_t plan_index, const uint8_t *input, uint8_t *output, size_t size,
+    bool to_native) const {
+  const Plan &plan = plans_[plan_index];
+  size_t offset = 0;
+  for (size_t i = 0; i < plan.size(); i++) {
+    const Operation &operation = plan[i];
+    switch (operation.kind) {
+      case Operation::RUN: {
+        uint64_t bytes = static_cast<uint64_t>(operation.count) * operation.width;
+        checkSize(offset, bytes, size);
+        swapRun(operation.width, input + offset, output + offset,
+                operation.count);
+        offset += bytes;
+        break;
+      }
+      case Operation::STRING: {
+        checkSize(offset, 4, size);
+        uint32_t length = readLength(input + offset, to_native);
+        checkSize(offset + 4, length, size);
+        writeSwapped(output + offset, readLength(input + offset, false));
+        swapRun(1, input + offset + 4, output + offset + 4, length);
+        offset += 4 + length;
+        break;
+      }
+      case Operation::PREFIXED_RUN: {
+        checkSize(offset, 4, size);
+        uint32_t length = readLength(input + offset, to_native);
+        uint64_t count = static_cast<uint64_t>(length) * operation.count;
+        // count * width can not overflow since both are at most 32 bits.
+        checkSize(offset + 4, count * operation.width, size);
+        writeSwapped(output + offset, readLength(input + offset, false));
+        swapRun(operation.width, input + offset + 4, output + offset + 4,
+                count);
+        offset += 4 + count * operation.width;
+        break;
+      }
+      case Operation::STRINGS:
+      case Operation::MESSAGES: {
+        uint32_t count = operation.count;
+        if (count == CompiledField::kUnbounded) {
+          checkSize(offset, 4, size);
+          count = readLength(input + offset, to_native);
+          writeSwapped(output + offset, readLength(input + offset, false));
+          offset += 4;
+        }
+        for (uint32_t j = 0; j < count; j++) {
+          if (operation.kind == Operation::STRINGS) {
+            checkSize(offset, 4, size);
+            uint32_t length = readLength(input + offset, to_native);
+            checkSize(offset + 4, length, size);
+            writeSwapped(output + offset, readLength(input + offset, false));
+            swapRun(1, input + offset + 4, output + offset + 4, length);
+            offset += 4 + length;
+          } else {
+            offset += run(
+                operation.plan, input + offset, output + offset,
+                size - offset, to_native);
+          }
+        }
+        break;
+      }
+    }
+  }
+  return offset;
+}
+
+}  // namespace generic_message
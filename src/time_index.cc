@@ -0,0 +1,348 @@
+/**
+ * Copyright (c) 2013, Lorenz Moesenlechner <moesenle@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The names of the contributors may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <generic_message/time_index.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+
+#include <boost/static_assert.hpp>
+
+namespace generic_message {
+
+namespace {
+
+const char kMagic[8] = {'G', 'M', 'T', 'I', 'D', 'X', '0', '1'};
+const uint32_t kVersion = 1;
+
+struct IndexHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t block_size;
+  uint64_t entry_count;
+  uint64_t block_count;
+  // Size of the delta area behind the block table.
+  uint64_t delta_size;
+  // Size of the stream the index was built for, to detect stale indices.
+  uint64_t stream_size;
+  char fingerprint[32];
+};
+
+BOOST_STATIC_ASSERT(sizeof(IndexHeader) % 8 == 0);
+
+uint32_t readLength(const uint8_t *data) {
+  uint32_t length;
+  memcpy(&length, data, sizeof(length));
+  return length;
+}
+
+void appendVarint(std::vector<uint8_t> *output, uint64_t value) {
+  while (value >= 0x80) {
+    output->push_back(static_cast<uint8_t>(value) | 0x80);
+    value >>= 7;
+  }
+  output->push_back(static_cast<uint8_t>(value));
+}
+
+uint64_t readVarint(const uint8_t **data, const uint8_t *end) {
+  uint64_t value = 0;
+  for (unsigned shift = 0; shift < 64; shift += 7) {
+    if (*data == end) {
+      break;
+    }
+    uint8_t byte = *(*data)++;
+    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) {
+      return value;
+    }
+  }
+  throw TimeIndexError("Time index is corrupted");
+}
+
+// Offsets are not sorted by time stamp, so their deltas may be negative.
+uint64_t zigzag(int64_t value) {
+  return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+int64_t unzigzag(uint64_t value) {
+  return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+std::string systemError(const std::string &message) {
+  return message + ": " + strerror(errno);
+}
+
+}  // namespace
+
+// A read-only mapping of a whole file.
+class MappedFile : private boost::noncopyable {
+ public:
+  explicit MappedFile(const std::string &file) : data_(0), size_(0) {
+    int fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      throw TimeIndexError(systemError("Unable to open " + file));
+    }
+    struct stat status;
+    if (fstat(fd, &status) != 0) {
+      std::string error = systemError("Unable to stat " + file);
+      close(fd);
+      throw TimeIndexError(error);
+    }
+    size_ = status.st_size;
+    if (size_ > 0) {
+      void *data = mmap(0, size_, PROT_READ, MAP_SHARED, fd, 0);
+      if (data == MAP_FAILED) {
+        std::string error = systemError("Unable to map " + file);
+        close(fd);
+        throw TimeIndexError(error);
+      }
+      data_ = reinterpret_cast<const uint8_t *>(data);
+    }
+    close(fd);
+  }
+
+  ~MappedFile() {
+    if (data_) {
+      munmap(const_cast<uint8_t *>(data_), size_);
+    }
+  }
+
+  const uint8_t *data() const { return data_; }
+  size_t size() const { return size_; }
+
+ private:
+  const uint8_t *data_;
+  size_t size_;
+};
+
+struct TimeIndex::Block {
+  uint64_t stamp;
+  uint64_t offset;
+  // Position of the block's deltas in the delta area.
+  uint64_t deltas;
+};
+
+const uint32_t TimeIndex::kBlockSize;
+
+TimeIndexBuilder::TimeIndexBuilder(
+    const CompiledMessage &message, const std::string &time_path)
+    : message_(&message), path_(&message.fieldPath(time_path)),
+      stream_size_(0) {
+  const BaseType *type = boost::get<BaseType>(&path_->type());
+  if (!type || type->type != BaseType::TIME) {
+    throw TimeIndexError(time_path + " is not a time field");
+  }
+}
+
+void TimeIndexBuilder::add(const void *data, size_t size, uint64_t offset) {
+  // Validating first makes evaluating the path safe for corrupted data.
+  if (message_->checkedSize(data, size) != size) {
+    throw InvalidMessage("Message is smaller than its length prefix");
+  }
+  const uint8_t *stamp =
+      reinterpret_cast<const uint8_t *>(data) + path_->offset(data);
+  uint32_t time[2];
+  memcpy(time, stamp, sizeof(time));
+  entries_.push_back(std::make_pair(
+      TimeIndex::toNanoseconds(time[0], time[1]), offset));
+  stream_size_ = std::max<uint64_t>(stream_size_, offset + 4 + size);
+}
+
+void TimeIndexBuilder::addStream(
+    const void *data, size_t size, uint64_t offset) {
+  const uint8_t *bytes = reinterpret_cast<const uint8_t *>(data);
+  size_t position = 0;
+  while (position < size) {
+    if (size - position < 4 || readLength(bytes + position) > size - position - 4) {
+      throw TimeIndexError("Stream is truncated");
+    }
+    uint32_t length = readLength(bytes + position);
+    add(bytes + position + 4, length, offset + position);
+    position += 4 + length;
+  }
+}
+
+void TimeIndexBuilder::addStreamFile(const std::string &stream_file) {
+  MappedFile stream(stream_file);
+  addStream(stream.data(), stream.size());
+}
+
+void TimeIndexBuilder::write(const std::string &index_file) const {
+  std::vector<std::pair<uint64_t, uint64_t> > entries(entries_);
+  std::sort(entries.begin(), entries.end());
+  std::vector<TimeIndex::Block> blocks;
+  std::vector<uint8_t> deltas;
+  for (size_t i = 0; i < entries.size(); i++) {
+    if (i % TimeIndex::kBlockSize == 0) {
+      TimeIndex::Block block = {entries[i].first, entries[i].second,
+                                deltas.size()};
+      blocks.push_back(block);
+    } else {
+      appendVarint(&deltas, entries[i].first - entries[i - 1].first);
+      appendVarint(&deltas, zigzag(static_cast<int64_t>(
+          entries[i].second - entries[i - 1].second)));
+    }
+  }
+  IndexHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.block_size = TimeIndex::kBlockSize;
+  header.entry_count = entries.size();
+  header.block_count = blocks.size();
+  header.delta_size = deltas.size();
+  header.stream_size = stream_size_;
+  std::string fingerprint = message_->fingerprint();
+  // Fixed width and not terminated if the fingerprint fills it.
+  memcpy(header.fingerprint, fingerprint.data(),
+         std::min(fingerprint.size(), sizeof(header.fingerprint)));
+
+  std::ofstream output(index_file.c_str(), std::ios::binary | std::ios::trunc);
+  output.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  if (!blocks.empty()) {
+    output.write(reinterpret_cast<const char *>(&blocks[0]),
+                 blocks.size() * sizeof(TimeIndex::Block));
+  }
+  if (!deltas.empty()) {
+    output.write(reinterpret_cast<const char *>(&deltas[0]), deltas.size());
+  }
+  output.close();
+  if (!output) {
+    throw TimeIndexError("Unable to write " + index_file);
+  }
+}
+
+TimeIndex::TimeIndex(
+    const CompiledMessage &message, const std::string &stream_file,
+    const std::string &index_file)
+    : stream_(new MappedFile(stream_file)), index_(new MappedFile(index_file)),
+      entry_count_(0), block_count_(0), blocks_(0), deltas_(0),
+      deltas_end_(0) {
+  if (index_->size() < sizeof(IndexHeader)) {
+    throw TimeIndexError(index_file + " is not a time index");
+  }
+  IndexHeader header;
+  memcpy(&header, index_->data(), sizeof(header));
+  if (memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+      header.version != kVersion || header.block_size != kBlockSize) {
+    throw TimeIndexError(index_file + " is not a time index");
+  }
+  size_t available = index_->size() - sizeof(IndexHeader);
+  if (header.block_count > available / sizeof(Block) ||
+      header.delta_size != available - header.block_count * sizeof(Block) ||
+      header.block_count !=
+          (header.entry_count + kBlockSize - 1) / kBlockSize) {
+    throw TimeIndexError(index_file + " is corrupted");
+  }
+  std::string fingerprint(
+      header.fingerprint,
+      strnlen(header.fingerprint, sizeof(header.fingerprint)));
+  if (fingerprint != message.fingerprint()) {
+    throw TimeIndexError(
+        index_file + " was built for a different message type");
+  }
+  if (header.stream_size != stream_->size()) {
+    throw TimeIndexError(index_file + " does not match " + stream_file);
+  }
+  entry_count_ = header.entry_count;
+  block_count_ = header.block_count;
+  blocks_ = reinterpret_cast<const Block *>(
+      index_->data() + sizeof(IndexHeader));
+  deltas_ = reinterpret_cast<const uint8_t *>(blocks_ + block_count_);
+  deltas_end_ = deltas_ + header.delta_size;
+}
+
+TimeIndex::~TimeIndex() {
+}
+
+void TimeIndex::query(
+    uint64_t begin, uint64_t end, std::vector<Entry> *entries) const {
+  entries->clear();
+  if (begin >= end || block_count_ == 0) {
+    return;
+  }
+  // Entries equal to begin may trail the block before the first block
+  // that starts at or after begin.
+  size_t low = 0;
+  size_t high = block_count_;
+  while (low < high) {
+    size_t middle = low + (high - low) / 2;
+    if (blocks_[middle].stamp < begin) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  for (size_t block = low > 0 ? low - 1 : 0; block < block_count_; block++) {
+    Entry entry = {blocks_[block].stamp, blocks_[block].offset};
+    if (entry.stamp >= end) {
+      return;
+    }
+    if (blocks_[block].deltas > static_cast<uint64_t>(deltas_end_ - deltas_)) {
+      throw TimeIndexError("Time index is corrupted");
+    }
+    const uint8_t *current = deltas_ + blocks_[block].deltas;
+    size_t count = std::min<uint64_t>(
+        kBlockSize, entry_count_ - block * kBlockSize);
+    for (size_t i = 0; i < count; i++) {
+      if (i > 0) {
+        entry.stamp += readVarint(&current, deltas_end_);
+        entry.offset += unzigzag(readVarint(&current, deltas_end_));
+      }
+      if (entry.stamp >= end) {
+        return;
+      }
+      if (entry.stamp >= begin) {
+        entries->push_back(entry);
+      }
+    }
+  }
+}
+
+const void *TimeIndex::message(const Entry &entry, size_t *size) const {
+  if (entry.offset > stream_->size() || stream_->size() - entry.offset < 4) {
+    throw TimeIndexError("Entry is outside of the stream");
+  }
+  const uint8_t *data = stream_->data() + entry.offset;
+  uint32_t length = readLength(data);
+  if (length > stream_->size() - entry.offset - 4) {
+    throw TimeIndexError("Entry is outside of the stream");
+  }
+  *size = length;
+  return data + 4;
+}
+
+}  // namespace generic_message
@@ -0,0 +1,127 @@
+/**
+ * Copyright (c) 2013, Lorenz Moesenlechner <moesenle@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The names of the contributors may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+
+#include <vector>
+
+#include <boost/atomic.hpp>
+#include <boost/bind/bind.hpp>
+#include <boost/scoped_array.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <generic_message/batch_executor.h>
+#include <generic_message/message_pool.h>
+
+using namespace generic_message;
+
+namespace {
+
+const size_t kThreads = 4;
+
+void countCall(
+    boost::atomic<unsigned> *calls, size_t index, const MessageView &,
+    BatchScratch *) {
+  calls[index].fetch_add(1, boost::memory_order_relaxed);
+}
+
+void throwInteger(size_t index, const MessageView &, BatchScratch *) {
+  if (index == 3) {
+    throw 42;
+  }
+}
+
+struct ExecutorFixture {
+  MessagePool pool;
+  BatchExecutor executor;
+  std::vector<uint8_t> buffer;
+
+  ExecutorFixture() : executor(kThreads), buffer(4) {
+    pool.add("test_msgs", "Value", "uint32 value\n");
+  }
+
+  const CompiledMessage &message() const {
+    return pool.get("test_msgs", "Value");
+  }
+};
+
+}  // namespace
+
+BOOST_FIXTURE_TEST_SUITE(batch_executor, ExecutorFixture)
+
+// Batches smaller than the number of threads leave some workers without a
+// share, so they start by stealing.
+BOOST_AUTO_TEST_CASE(calls_back_once_per_index) {
+  const size_t kSizes[] = {
+    1, kThreads - 1, kThreads, kThreads + 1, 100, 1000};
+  BOOST_CHECK_EQUAL(executor.threadCount(), kThreads);
+  for (size_t i = 0; i < sizeof(kSizes) / sizeof(kSizes[0]); i++) {
+    size_t size = kSizes[i];
+    std::vector<const void *> buffers(size, &buffer[0]);
+    for (size_t round = 0; round < 20; round++) {
+      boost::scoped_array<boost::atomic<unsigned> > calls(
+          new boost::atomic<unsigned>[size]);
+      for (size_t j = 0; j < size; j++) {
+        calls[j] = 0;
+      }
+      executor.forEach(message(), buffers, boost::bind(
+          &countCall, calls.get(), boost::placeholders::_1,
+          boost::placeholders::_2, boost::placeholders::_3));
+      for (size_t j = 0; j < size; j++) {
+        BOOST_TEST_CONTEXT("size " << size << ", index " << j) {
+          BOOST_REQUIRE_EQUAL(calls[j].load(), 1u);
+        }
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(reports_exceptions_of_any_type) {
+  std::vector<const void *> buffers(10, &buffer[0]);
+  try {
+    executor.forEach(message(), buffers, &throwInteger);
+    BOOST_FAIL("Expected BatchFailed");
+  } catch (const BatchFailed &e) {
+    BOOST_CHECK_EQUAL(e.index(), 3u);
+  }
+  // The executor stays usable after a failure.
+  boost::scoped_array<boost::atomic<unsigned> > calls(
+      new boost::atomic<unsigned>[buffers.size()]);
+  for (size_t i = 0; i < buffers.size(); i++) {
+    calls[i] = 0;
+  }
+  executor.forEach(message(), buffers, boost::bind(
+      &countCall, calls.get(), boost::placeholders::_1,
+      boost::placeholders::_2, boost::placeholders::_3));
+  for (size_t i = 0; i < buffers.size(); i++) {
+    BOOST_CHECK_EQUAL(calls[i].load(), 1u);
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
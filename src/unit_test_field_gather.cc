@@ -0,0 +1,156 @@
+/**
+ * Copyright (c) 2013, Lorenz Moesenlechner <moesenle@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The names of the contributors may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+#include <generic_message/field_gather.h>
+#include <generic_message/json_encoder.h>
+#include <generic_message/message_pool.h>
+
+using namespace generic_message;
+
+namespace {
+
+// Not a multiple of the four lanes of the AVX2 gathers, so the scalar
+// remainder runs after the vector loop.
+const size_t kBufferCount = 13;
+const size_t kCounts[] = {0, 1, 3, 4, 5, 8, 13};
+
+// Buffers with strings of different lengths in front of the fields after
+// the label, so those fields are at a different offset in every buffer.
+struct GatherFixture {
+  MessagePool pool;
+  std::vector<std::vector<uint8_t> > buffers;
+  std::vector<const void *> pointers;
+
+  GatherFixture() {
+    pool.add("test_msgs", "Gathered",
+             "uint32 seq\n"
+             "time stamp\n"
+             "uint16 flags\n"
+             "uint8[3] rgb\n"
+             "float64 fixed_value\n"
+             "string label\n"
+             "uint32 count\n"
+             "float64 value\n"
+             "uint8[3] color\n");
+    buffers.resize(kBufferCount);
+    for (size_t i = 0; i < kBufferCount; i++) {
+      std::ostringstream json;
+      json << "{\"seq\": " << 1000 + i << ","
+           << " \"stamp\": {\"secs\": " << 2000 + i
+           << ", \"nsecs\": " << 3000 + i << "},"
+           << " \"flags\": " << 40 + i << ","
+           << " \"rgb\": [" << i << ", " << 2 * i << ", " << 3 * i << "],"
+           << " \"fixed_value\": " << i + 0.25 << ","
+           << " \"label\": \"" << std::string(i * 3, 'l') << "\","
+           << " \"count\": " << 5000 + i << ","
+           << " \"value\": " << i + 0.5 << ","
+           << " \"color\": [" << 4 * i << ", " << 5 * i << ", " << 6 * i
+           << "]}";
+      JsonEncoder().encode(message(), json.str(), &buffers[i]);
+      pointers.push_back(&buffers[i][0]);
+    }
+  }
+
+  const CompiledMessage &message() const {
+    return pool.get("test_msgs", "Gathered");
+  }
+
+  // Gathers path for every count and compares each element with the bytes
+  // at the offset fieldPath() computes for its buffer.
+  void checkGather(const std::string &path, size_t size) const {
+    FieldGather gather(message(), path);
+    BOOST_CHECK_EQUAL(gather.size(), size);
+    const FieldPath &field_path = message().fieldPath(path);
+    for (size_t c = 0; c < sizeof(kCounts) / sizeof(kCounts[0]); c++) {
+      size_t count = kCounts[c];
+      BOOST_TEST_CONTEXT(path << " from " << count << " buffers") {
+        // One element more than gathered to catch writes past the end.
+        std::vector<uint8_t> output((count + 1) * size, 0xee);
+        gather.gather(&pointers[0], count, &output[0]);
+        for (size_t i = 0; i < count; i++) {
+          const uint8_t *field =
+              &buffers[i][0] + field_path.offset(&buffers[i][0]);
+          BOOST_CHECK_EQUAL(memcmp(&output[i * size], field, size), 0);
+        }
+        BOOST_CHECK_EQUAL(output[count * size], 0xee);
+      }
+    }
+  }
+};
+
+}  // namespace
+
+BOOST_FIXTURE_TEST_SUITE(field_gather, GatherFixture)
+
+BOOST_AUTO_TEST_CASE(gathers_fixed_offsets) {
+  checkGather("seq", 4);
+  checkGather("stamp", 8);
+  checkGather("flags", 2);
+  checkGather("rgb", 3);
+  checkGather("rgb[1]", 1);
+  checkGather("fixed_value", 8);
+}
+
+BOOST_AUTO_TEST_CASE(gathers_dynamic_offsets) {
+  checkGather("count", 4);
+  checkGather("value", 8);
+  checkGather("color", 3);
+  checkGather("color[2]", 1);
+}
+
+BOOST_AUTO_TEST_CASE(gathers_typed_values) {
+  std::vector<uint32_t> counts;
+  FieldGather(message(), "count").gather(pointers, &counts);
+  BOOST_REQUIRE_EQUAL(counts.size(), kBufferCount);
+  std::vector<double> values;
+  FieldGather(message(), "fixed_value").gather(pointers, &values);
+  BOOST_REQUIRE_EQUAL(values.size(), kBufferCount);
+  for (size_t i = 0; i < kBufferCount; i++) {
+    BOOST_CHECK_EQUAL(counts[i], 5000 + i);
+    BOOST_CHECK_EQUAL(values[i], i + 0.25);
+  }
+  BOOST_CHECK_THROW(
+      FieldGather(message(), "count").gather(pointers, &values),
+      GatherFailed);
+}
+
+BOOST_AUTO_TEST_CASE(rejects_dynamic_fields) {
+  BOOST_CHECK_THROW(FieldGather(message(), "label"), GatherFailed);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
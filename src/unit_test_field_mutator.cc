@@ -0,0 +1,193 @@
+/**
+ * Copyright (c) 2013, Lorenz Moesenlechner <moesenle@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The names of the contributors may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include <boost/lexical_cast.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <generic_message/field_mutator.h>
+#include <generic_message/json_encoder.h>
+#include <generic_message/message_buffer.h>
+#include <generic_message/message_pool.h>
+
+using namespace generic_message;
+
+namespace {
+
+// Mutations are checked against the encoding of the message they should
+// produce, so every byte behind the mutated field has to end up in the
+// right place.
+struct MutatorFixture {
+  MessagePool pool;
+
+  MutatorFixture() {
+    pool.add("std_msgs", "Header",
+             "uint32 seq\n"
+             "time stamp\n"
+             "string frame_id\n");
+    pool.add("test_msgs", "Mutated",
+             "std_msgs/Header header\n"
+             "uint32 id\n"
+             "string name\n"
+             "uint16[] values\n"
+             "float64 ratio\n"
+             "string tail\n");
+  }
+
+  const CompiledMessage &message() const {
+    return pool.get("test_msgs", "Mutated");
+  }
+
+  std::vector<uint8_t> encode(
+      const std::string &frame_id, uint32_t sec, uint32_t id,
+      const std::string &name, const std::string &values) const {
+    std::vector<uint8_t> buffer;
+    JsonEncoder().encode(
+        message(),
+        "{\"header\": {\"seq\": 3, \"stamp\": {\"secs\": " +
+        boost::lexical_cast<std::string>(sec) + ", \"nsecs\": 250},"
+        "              \"frame_id\": \"" + frame_id + "\"},"
+        " \"id\": " + boost::lexical_cast<std::string>(id) + ","
+        " \"name\": \"" + name + "\","
+        " \"values\": " + values + ","
+        " \"ratio\": 0.5,"
+        " \"tail\": \"end of message\"}",
+        &buffer);
+    return buffer;
+  }
+
+  std::vector<uint8_t> original() const {
+    return encode("map", 100, 1, "middle", "[1, 2, 3]");
+  }
+
+  void checkBuffer(
+      const MessageBuffer &buffer, const std::vector<uint8_t> &expected) {
+    BOOST_CHECK_EQUAL(message().size(buffer.data()), buffer.size());
+    BOOST_CHECK_EQUAL_COLLECTIONS(
+        buffer.data(), buffer.data() + buffer.size(),
+        expected.begin(), expected.end());
+  }
+};
+
+}  // namespace
+
+BOOST_FIXTURE_TEST_SUITE(field_mutator, MutatorFixture)
+
+BOOST_AUTO_TEST_CASE(overwrites_fixed_fields_in_place) {
+  std::vector<uint8_t> original = this->original();
+  MessageBuffer buffer(&original[0], original.size());
+  const uint8_t *data = buffer.data();
+  FieldMutator(message(), "id").set<uint32_t>(buffer.data(), 42);
+  BOOST_CHECK(buffer.data() == data);
+  checkBuffer(buffer, encode("map", 100, 42, "middle", "[1, 2, 3]"));
+  BOOST_CHECK_THROW(
+      FieldMutator(message(), "id").set<uint16_t>(buffer.data(), 1),
+      MutationFailed);
+  BOOST_CHECK_THROW(
+      FieldMutator(message(), "name").set<uint32_t>(buffer.data(), 1),
+      MutationFailed);
+}
+
+BOOST_AUTO_TEST_CASE(resizes_strings) {
+  std::vector<uint8_t> original = this->original();
+  MessageBuffer buffer(&original[0], original.size());
+  FieldMutator name(message(), "name");
+  name.setString(&buffer, "a much longer name in the middle");
+  checkBuffer(buffer, encode("map", 100, 1, "a much longer name in the middle",
+                             "[1, 2, 3]"));
+  name.setString(&buffer, "m");
+  checkBuffer(buffer, encode("map", 100, 1, "m", "[1, 2, 3]"));
+  name.setString(&buffer, "");
+  checkBuffer(buffer, encode("map", 100, 1, "", "[1, 2, 3]"));
+  BOOST_CHECK_THROW(
+      FieldMutator(message(), "id").setString(&buffer, "1"), MutationFailed);
+}
+
+BOOST_AUTO_TEST_CASE(resizes_arrays) {
+  std::vector<uint8_t> original = this->original();
+  MessageBuffer buffer(&original[0], original.size());
+  FieldMutator values(message(), "values");
+  uint16_t longer[] = {10, 20, 30, 40, 50, 60, 70};
+  values.setArray(&buffer, longer, 7);
+  checkBuffer(buffer, encode("map", 100, 1, "middle",
+                             "[10, 20, 30, 40, 50, 60, 70]"));
+  values.setArray(&buffer, longer, 1);
+  checkBuffer(buffer, encode("map", 100, 1, "middle", "[10]"));
+  values.setArray(&buffer, longer, 0);
+  checkBuffer(buffer, encode("map", 100, 1, "middle", "[]"));
+}
+
+BOOST_AUTO_TEST_CASE(resizes_vectors) {
+  std::vector<uint8_t> buffer = original();
+  FieldMutator(message(), "name").setString(&buffer, "a longer name");
+  uint16_t values[] = {7, 8};
+  FieldMutator(message(), "values").setArray(&buffer, values, 2);
+  BOOST_CHECK(buffer == encode("map", 100, 1, "a longer name", "[7, 8]"));
+  FieldMutator(message(), "name").setString(&buffer, "n");
+  BOOST_CHECK(buffer == encode("map", 100, 1, "n", "[7, 8]"));
+  BOOST_CHECK_EQUAL(message().size(&buffer[0]), buffer.size());
+}
+
+BOOST_AUTO_TEST_CASE(rewrites_header) {
+  std::vector<uint8_t> original = this->original();
+  MessageBuffer buffer(&original[0], original.size());
+  FieldMutator(message(), "header.frame_id").setString(&buffer, "odom_frame");
+  FieldMutator(message(), "header.stamp").setTime(buffer.data(), 2000, 250);
+  checkBuffer(buffer, encode("odom_frame", 2000, 1, "middle", "[1, 2, 3]"));
+  BOOST_CHECK_THROW(
+      FieldMutator(message(), "header.frame_id").setTime(buffer.data(), 0, 0),
+      MutationFailed);
+}
+
+BOOST_AUTO_TEST_CASE(grows_within_capacity) {
+  std::vector<uint8_t> original = this->original();
+  MessageBuffer buffer(&original[0], original.size());
+  BOOST_CHECK_EQUAL(buffer.capacity(),
+                    original.size() + MessageBuffer::kDefaultSlack);
+  const uint8_t *data = buffer.data();
+  std::string name(6 + MessageBuffer::kDefaultSlack, 'n');
+  FieldMutator mutator(message(), "name");
+  mutator.setString(&buffer, name);
+  BOOST_CHECK(buffer.data() == data);
+  BOOST_CHECK_EQUAL(buffer.size(), buffer.capacity());
+  mutator.setString(&buffer, "middle");
+  BOOST_CHECK(buffer.data() == data);
+  checkBuffer(buffer, original);
+
+  // One more byte than the spare capacity has to reallocate.
+  mutator.setString(&buffer, name + "n");
+  BOOST_CHECK_GT(buffer.capacity(), buffer.size());
+  checkBuffer(buffer, encode("map", 100, 1, name + "n", "[1, 2, 3]"));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
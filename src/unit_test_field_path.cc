@@ -0,0 +1,107 @@
+/**
+ * Copyright (c) 2013, Lorenz Moesenlechner <moesenle@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The names of the contributors may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+#include <generic_message/compiled_message.h>
+#include <generic_message/field_mutator.h>
+#include <generic_message/field_path.h>
+#include <generic_message/json_encoder.h>
+#include <generic_message/message_pool.h>
+
+using namespace generic_message;
+
+namespace {
+
+struct ArrayFixture {
+  MessagePool pool;
+  std::vector<uint8_t> buffer;
+
+  ArrayFixture() {
+    pool.add("test_msgs", "Arrays",
+             "string label\nuint8[] data\nfloat64[3] fixed\nstring[] names\n");
+    JsonEncoder().encode(
+        message(),
+        "{\"label\": \"abc\", \"data\": [1, 2, 3], \"fixed\": [4, 5, 6], "
+        "\"names\": [\"x\", \"yz\"]}",
+        &buffer);
+  }
+
+  const CompiledMessage &message() const {
+    return pool.get("test_msgs", "Arrays");
+  }
+};
+
+}  // namespace
+
+BOOST_FIXTURE_TEST_SUITE(field_path, ArrayFixture)
+
+BOOST_AUTO_TEST_CASE(indexes_arrays) {
+  BOOST_CHECK_EQUAL(message().fieldPath("data[2]").offset(&buffer[0]), 13u);
+  BOOST_CHECK_EQUAL(buffer[message().fieldPath("data[2]").offset(&buffer[0])], 3);
+  BOOST_CHECK_EQUAL(message().fieldPath("names[1]").offset(&buffer[0]), 47u);
+  BOOST_CHECK_EQUAL(message().fieldPath("names[1]").size(&buffer[0]), 6u);
+}
+
+BOOST_AUTO_TEST_CASE(rejects_out_of_range_indices) {
+  BOOST_CHECK_THROW(message().fieldPath("fixed[3]"), FieldNotFound);
+  BOOST_CHECK_THROW(
+      message().fieldPath("data[3]").offset(&buffer[0]), IndexOutOfRange);
+  BOOST_CHECK_THROW(
+      message().fieldPath("data[4294967295]").offset(&buffer[0]),
+      IndexOutOfRange);
+}
+
+// Indices that do not fit into the 32 bit length prefix of an array used
+// to be truncated by the bounds check but not by the offset computation.
+BOOST_AUTO_TEST_CASE(rejects_indices_beyond_32_bits) {
+  BOOST_CHECK_THROW(message().fieldPath("data[4294967296]"), FieldNotFound);
+  BOOST_CHECK_THROW(message().fieldPath("names[4294967296]"), FieldNotFound);
+  BOOST_CHECK_THROW(message().fieldPath("data[-1]"), FieldNotFound);
+  BOOST_CHECK_THROW(
+      FieldMutator(message(), "data[4294967296]"), FieldNotFound);
+}
+
+BOOST_AUTO_TEST_CASE(does_not_cache_invalid_paths) {
+  message().fieldPath("label");
+  size_t usage = message().memoryUsage();
+  for (size_t i = 0; i < 100; i++) {
+    BOOST_CHECK_THROW(message().fieldPath("missing.field"), FieldNotFound);
+    BOOST_CHECK_THROW(message().fieldPath("fixed[7]"), FieldNotFound);
+  }
+  BOOST_CHECK_EQUAL(message().memoryUsage(), usage);
+  BOOST_CHECK_EQUAL(&message().fieldPath("label"), &message().fieldPath("label"));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
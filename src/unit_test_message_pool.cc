@@ -0,0 +1,145 @@
+/**
+ * Copyright (c) 2013, Lorenz Moesenlechner <moesenle@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The names of the contributors may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string>
+
+#include <boost/test/unit_test.hpp>
+
+#include <generic_message/message_pool.h>
+#include <generic_message/statistics.h>
+
+#include "sample_messages.h"
+
+using namespace generic_message;
+
+namespace {
+
+struct SamplePoolFixture {
+  MessagePool pool;
+
+  SamplePoolFixture() {
+    addDefinitions(&pool);
+  }
+};
+
+}  // namespace
+
+BOOST_AUTO_TEST_SUITE(message_pool)
+
+// MD5 sums published with the ROS message packages.
+BOOST_FIXTURE_TEST_CASE(fingerprints_match_ros, SamplePoolFixture) {
+  const char *const kFingerprints[][3] = {
+    {"std_msgs", "Header", "2176decaecbce78abc3b96ef049fabed"},
+    {"geometry_msgs", "Point", "4a842b65f413084dc2b10fb484ea7f17"},
+    {"geometry_msgs", "Quaternion", "a779879fadf0160734f906b8c19c7004"},
+    {"geometry_msgs", "Pose", "e45d45a5a1ce597b249e23fb30fc871f"},
+    {"geometry_msgs", "PoseArray", "916c28c5764443f268b296bb671b9d97"},
+    {"nav_msgs", "Odometry", "cd5e73d190d741a2f92e81eda573aca7"},
+    {"sensor_msgs", "Imu", "6a62c6daae103f4ff57a132d6f95cec2"},
+    {"sensor_msgs", "JointState", "3066dcd76a6cfaef579bd0f34173e9fd"},
+    {"sensor_msgs", "PointField", "268eacb2962780ceac86cbd17e328150"},
+    {"sensor_msgs", "PointCloud2", "1158d486dd51d683ce2f1be655c3c181"},
+    {"tf2_msgs", "TFMessage", "94810edda583a504dfda3829e70d7eec"},
+  };
+  const size_t count = sizeof(kFingerprints) / sizeof(kFingerprints[0]);
+  for (size_t i = 0; i < count; i++) {
+    BOOST_TEST_CONTEXT(kFingerprints[i][0] << "/" << kFingerprints[i][1]) {
+      BOOST_CHECK_EQUAL(
+          pool.fingerprint(kFingerprints[i][0], kFingerprints[i][1]),
+          kFingerprints[i][2]);
+      BOOST_CHECK_EQUAL(
+          pool.getByFingerprint(kFingerprints[i][2]).fingerprint(),
+          kFingerprints[i][2]);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(indexes_fingerprints_when_dependencies_are_added) {
+  MessagePool pool;
+  pool.add("geometry_msgs", "Pose",
+           "geometry_msgs/Point position\n"
+           "geometry_msgs/Quaternion orientation\n");
+  pool.add("geometry_msgs", "Point", "float64 x\nfloat64 y\nfloat64 z\n");
+  BOOST_CHECK_THROW(
+      pool.getByFingerprint("e45d45a5a1ce597b249e23fb30fc871f"),
+      MessageNotFound);
+  BOOST_CHECK_EQUAL(
+      pool.getByFingerprint("4a842b65f413084dc2b10fb484ea7f17").type().name,
+      "Point");
+  pool.add("geometry_msgs", "Quaternion",
+           "float64 x\nfloat64 y\nfloat64 z\nfloat64 w\n");
+  BOOST_CHECK_EQUAL(
+      pool.getByFingerprint("e45d45a5a1ce597b249e23fb30fc871f").type().name,
+      "Pose");
+}
+
+BOOST_AUTO_TEST_CASE(reindexes_replaced_definitions) {
+  MessagePool pool;
+  pool.add("test_msgs", "Inner", "int32 a\n");
+  pool.add("test_msgs", "Outer", "test_msgs/Inner inner\n");
+  std::string outer = pool.fingerprint("test_msgs", "Outer");
+  BOOST_CHECK_EQUAL(pool.getByFingerprint(outer).type().name, "Outer");
+  pool.add("test_msgs", "Inner", "int64 a\n");
+  BOOST_CHECK_THROW(pool.getByFingerprint(outer), MessageNotFound);
+  std::string replaced = pool.fingerprint("test_msgs", "Outer");
+  BOOST_CHECK_NE(replaced, outer);
+  BOOST_CHECK_EQUAL(pool.getByFingerprint(replaced).type().name, "Outer");
+}
+
+BOOST_AUTO_TEST_CASE(skips_recursive_definitions) {
+  MessagePool pool;
+  pool.add("test_msgs", "A", "test_msgs/B b\n");
+  pool.add("test_msgs", "B", "test_msgs/A a\n");
+  pool.add("test_msgs", "C", "int32 c\n");
+  std::string c = pool.fingerprint("test_msgs", "C");
+  BOOST_CHECK_EQUAL(pool.getByFingerprint(c).type().name, "C");
+}
+
+// Lookups of the pool itself, e.g. while fingerprinting, are not counted.
+// Compiling looks up the type of each message field with getShared,
+// which counts like any other caller.
+BOOST_AUTO_TEST_CASE(counts_public_lookups) {
+  if (!statisticsEnabled()) {
+    return;
+  }
+  MessagePool pool;
+  pool.add("geometry_msgs", "Point", "float64 x\nfloat64 y\nfloat64 z\n");
+  pool.add("geometry_msgs", "Pose",
+           "geometry_msgs/Point position\ngeometry_msgs/Point target\n");
+  resetStatistics();
+  pool.fingerprint("geometry_msgs", "Pose");
+  pool.get("geometry_msgs", "Pose");
+  pool.get("geometry_msgs", "Pose");
+  BOOST_CHECK_THROW(pool.get("geometry_msgs", "Twist"), MessageNotFound);
+  Statistics statistics = statisticsSnapshot();
+  BOOST_CHECK_EQUAL(statistics.pool_get_calls, 5u);
+  BOOST_CHECK_EQUAL(statistics.pool_get_misses, 1u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
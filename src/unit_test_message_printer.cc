@@ -0,0 +1,155 @@
+/**
+ * Copyright (c) 2013, Lorenz Moesenlechner <moesenle@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The names of the contributors may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+#include <generic_message/json_encoder.h>
+#include <generic_message/message_pool.h>
+#include <generic_message/message_printer.h>
+
+using namespace generic_message;
+
+namespace {
+
+// A message with nested messages, fixed and dynamic arrays, strings that
+// need escaping and time and duration fields.
+struct PrinterFixture {
+  MessagePool pool;
+  std::vector<uint8_t> buffer;
+
+  PrinterFixture() {
+    pool.add("std_msgs", "Header",
+             "uint32 seq\n"
+             "time stamp\n"
+             "string frame_id\n");
+    pool.add("test_msgs", "Point",
+             "float64 x\n"
+             "float32 y\n");
+    pool.add("test_msgs", "Printed",
+             "std_msgs/Header header\n"
+             "test_msgs/Point[] points\n"
+             "int32[3] counts\n"
+             "string[] names\n"
+             "string quoted\n"
+             "duration period\n"
+             "bool flag\n"
+             "uint8[] empty\n"
+             "test_msgs/Point origin\n");
+    JsonEncoder().encode(
+        message(),
+        "{\"header\": {\"seq\": 7,"
+        "              \"stamp\": {\"secs\": 1400000000, \"nsecs\": 5000},"
+        "              \"frame_id\": \"base_link\"},"
+        " \"points\": [{\"x\": 1.5, \"y\": -2}, {\"x\": 0.1, \"y\": 3.25}],"
+        " \"counts\": [1, -2, 3],"
+        " \"names\": [\"a\", \"b c\"],"
+        " \"quoted\": \"say \\\"hi\\\"\\n\\ttab\\\\ \\u0001\","
+        " \"period\": {\"secs\": -1, \"nsecs\": 500000000},"
+        " \"flag\": true,"
+        " \"empty\": [],"
+        " \"origin\": {\"x\": 0, \"y\": 0}}",
+        &buffer);
+  }
+
+  const CompiledMessage &message() const {
+    return pool.get("test_msgs", "Printed");
+  }
+};
+
+}  // namespace
+
+BOOST_FIXTURE_TEST_SUITE(message_printer, PrinterFixture)
+
+BOOST_AUTO_TEST_CASE(prints_yaml) {
+  MessagePrinter printer(MessagePrinter::YAML);
+  BOOST_CHECK_EQUAL(
+      printer.print(message(), &buffer[0]),
+      "header:\n"
+      "  seq: 7\n"
+      "  stamp:\n"
+      "    sec: 1400000000\n"
+      "    nsec: 5000\n"
+      "  frame_id: \"base_link\"\n"
+      "points:\n"
+      "  - x: 1.5\n"
+      "    y: -2.0\n"
+      "  - x: 0.1\n"
+      "    y: 3.25\n"
+      "counts: [1, -2, 3]\n"
+      "names: [\"a\", \"b c\"]\n"
+      "quoted: \"say \\\"hi\\\"\\n\\ttab\\\\ \\x01\"\n"
+      "period:\n"
+      "  sec: -1\n"
+      "  nsec: 500000000\n"
+      "flag: true\n"
+      "empty: []\n"
+      "origin:\n"
+      "  x: 0.0\n"
+      "  y: 0.0\n");
+}
+
+BOOST_AUTO_TEST_CASE(prints_json) {
+  MessagePrinter printer(MessagePrinter::JSON);
+  BOOST_CHECK_EQUAL(
+      printer.print(message(), &buffer[0]),
+      "{\"header\":{\"seq\":7,"
+      "\"stamp\":{\"sec\":1400000000,\"nsec\":5000},"
+      "\"frame_id\":\"base_link\"},"
+      "\"points\":[{\"x\":1.5,\"y\":-2.0},{\"x\":0.1,\"y\":3.25}],"
+      "\"counts\":[1,-2,3],"
+      "\"names\":[\"a\",\"b c\"],"
+      "\"quoted\":\"say \\\"hi\\\"\\n\\ttab\\\\ \\u0001\","
+      "\"period\":{\"sec\":-1,\"nsec\":500000000},"
+      "\"flag\":true,"
+      "\"empty\":[],"
+      "\"origin\":{\"x\":0.0,\"y\":0.0}}");
+}
+
+BOOST_AUTO_TEST_CASE(truncates_long_arrays) {
+  MessagePrinter printer(MessagePrinter::YAML, 2);
+  const std::string &text = printer.print(message(), &buffer[0]);
+  BOOST_CHECK_NE(
+      text.find("counts: [1, -2, \"... 1 more\"]\n"), std::string::npos);
+  BOOST_CHECK_NE(text.find("names: [\"a\", \"b c\"]\n"), std::string::npos);
+}
+
+BOOST_AUTO_TEST_CASE(appends_to_output) {
+  MessagePrinter printer(MessagePrinter::JSON);
+  std::string output = "prefix ";
+  printer.print(message(), &buffer[0], &output);
+  BOOST_CHECK_EQUAL(
+      output, "prefix " + printer.print(message(), &buffer[0]));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,179 @@
+/**
+ * Copyright (c) 2013, Lorenz Moesenlechner <moesenle@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The names of the contributors may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+#include <generic_message/json_encoder.h>
+#include <generic_message/message_pool.h>
+#include <generic_message/message_traversal.h>
+
+using namespace generic_message;
+
+namespace {
+
+// Records every leaf with its path.
+class PathVisitor : public TraversalVisitor {
+ public:
+  PathVisitor() : skip_header(false) {}
+
+  bool beginField(const CompiledMessage &message, size_t field_index) {
+    std::string name = message.fieldName(field_index);
+    if (skip_header && name == "header") {
+      return false;
+    }
+    path_.push_back(name);
+    return true;
+  }
+  void endField(const CompiledMessage &, size_t) { path_.pop_back(); }
+  void element(size_t index) {
+    std::string &name = path_.back();
+    std::ostringstream element;
+    element << name.substr(0, name.find('[')) << "[" << index << "]";
+    name = element.str();
+  }
+
+  template<typename T>
+  void value(T value) { leaf() << +value << "\n"; }
+  void value(const StringValue &value) {
+    leaf() << "'" << std::string(value.data, value.size) << "'\n";
+  }
+  void value(const TimeValue &value) {
+    leaf() << value.sec << "." << value.nsec << "\n";
+  }
+  void value(const DurationValue &value) {
+    leaf() << value.sec << "." << value.nsec << "\n";
+  }
+
+  bool skip_header;
+  std::ostringstream out;
+
+ private:
+  std::vector<std::string> path_;
+
+  std::ostream &leaf() {
+    for (size_t i = 0; i < path_.size(); i++) {
+      out << (i ? "." : "") << path_[i];
+    }
+    return out << "=";
+  }
+};
+
+// Handles only floating point values and keeps the defaults for the rest.
+class FloatVisitor : public TraversalVisitor {
+ public:
+  using TraversalVisitor::value;
+
+  FloatVisitor() : count(0) {}
+
+  void value(float) { count++; }
+  void value(double) { count++; }
+
+  size_t count;
+};
+
+class BulkVisitor : public PathVisitor {
+ public:
+  bool arrayData(const CompiledField &, const void *, size_t count) {
+    out << "bulk " << count << "\n";
+    return true;
+  }
+};
+
+struct TraversalFixture {
+  MessagePool pool;
+  std::vector<uint8_t> buffer;
+
+  TraversalFixture() {
+    pool.add("std_msgs", "Header", "uint32 seq\ntime stamp\nstring frame_id\n");
+    pool.add("test_msgs", "Point", "float64 x\nstring label\n");
+    pool.add("test_msgs", "Sample",
+             "std_msgs/Header header\nfloat64[] values\nfloat32[2] pair\n"
+             "string[] names\ntest_msgs/Point[] points\nint16 last\n"
+             "bool flag\nduration period\n");
+    JsonEncoder().encode(
+        message(),
+        "{\"header\": {\"seq\": 3, \"stamp\": {\"secs\": 5, \"nsecs\": 6}, "
+        "\"frame_id\": \"map\"}, \"values\": [1.5, 2.5], \"pair\": [3, 4], "
+        "\"names\": [\"a\", \"bc\"], \"points\": [{\"x\": 7, \"label\": "
+        "\"q\"}], \"last\": -2, \"flag\": true, "
+        "\"period\": {\"secs\": -1, \"nsecs\": 0}}",
+        &buffer);
+  }
+
+  const CompiledMessage &message() const {
+    return pool.get("test_msgs", "Sample");
+  }
+};
+
+}  // namespace
+
+BOOST_FIXTURE_TEST_SUITE(message_traversal, TraversalFixture)
+
+BOOST_AUTO_TEST_CASE(visits_leaves_with_paths) {
+  PathVisitor visitor;
+  BOOST_CHECK_EQUAL(traverse(message(), &buffer[0], &visitor), buffer.size());
+  BOOST_CHECK_EQUAL(
+      visitor.out.str(),
+      "header.seq=3\nheader.stamp=5.6\nheader.frame_id='map'\n"
+      "values[0]=1.5\nvalues[1]=2.5\npair[0]=3\npair[1]=4\n"
+      "names[0]='a'\nnames[1]='bc'\npoints[0].x=7\npoints[0].label='q'\n"
+      "last=-2\nflag=1\nperiod=-1.0\n");
+}
+
+BOOST_AUTO_TEST_CASE(skips_fields) {
+  PathVisitor visitor;
+  visitor.skip_header = true;
+  BOOST_CHECK_EQUAL(traverse(message(), &buffer[0], &visitor), buffer.size());
+  BOOST_CHECK_EQUAL(visitor.out.str().find("header"), std::string::npos);
+  BOOST_CHECK_EQUAL(visitor.out.str().find("values[0]=1.5\n"), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(keeps_default_callbacks) {
+  FloatVisitor visitor;
+  traverse(message(), &buffer[0], &visitor);
+  BOOST_CHECK_EQUAL(visitor.count, 5u);
+}
+
+BOOST_AUTO_TEST_CASE(offers_arrays_in_bulk) {
+  BulkVisitor visitor;
+  traverse(message(), &buffer[0], &visitor);
+  BOOST_CHECK_EQUAL(
+      visitor.out.str(),
+      "header.seq=3\nheader.stamp=5.6\nheader.frame_id='map'\n"
+      "bulk 2\nbulk 2\nnames[0]='a'\nnames[1]='bc'\npoints[0].x=7\n"
+      "points[0].label='q'\nlast=-2\nflag=1\nperiod=-1.0\n");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
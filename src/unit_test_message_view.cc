@@ -0,0 +1,157 @@
+/**
+ * Copyright (c) 2013, Lorenz Moesenlechner <moesenle@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The names of the contributors may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+#include <generic_message/field_path.h>
+#include <generic_message/json_encoder.h>
+#include <generic_message/message_pool.h>
+#include <generic_message/message_view.h>
+
+using namespace generic_message;
+
+namespace {
+
+// More fields than fit into the inline offset table, alternating between
+// numbers and strings of different lengths so that every other offset is
+// dynamic.
+const size_t kFieldCount = 2 * MessageView::kInlineOffsets + 2;
+
+struct ViewFixture {
+  MessagePool pool;
+  std::vector<uint8_t> buffer;
+
+  ViewFixture() {
+    std::ostringstream definition;
+    std::ostringstream json;
+    json << "{";
+    for (size_t i = 0; i < kFieldCount; i++) {
+      json << (i ? ", " : "") << "\"f" << i << "\": ";
+      if (i % 2) {
+        definition << "string f" << i << "\n";
+        json << "\"" << std::string(i, 'x') << "\"";
+      } else {
+        definition << "uint32 f" << i << "\n";
+        json << 1000 + i;
+      }
+    }
+    json << "}";
+    pool.add("test_msgs", "Wide", definition.str());
+    JsonEncoder().encode(message(), json.str(), &buffer);
+  }
+
+  const CompiledMessage &message() const {
+    return pool.get("test_msgs", "Wide");
+  }
+
+  void checkField(const MessageView &view, size_t index) const {
+    std::ostringstream name;
+    name << "f" << index;
+    BOOST_TEST_CONTEXT("field " << name.str()) {
+      BOOST_CHECK_EQUAL(
+          view.offset(index),
+          message().fieldPath(name.str()).offset(&buffer[0]));
+      if (index % 2 == 0) {
+        BOOST_CHECK_EQUAL(view.value<uint32_t>(index), 1000 + index);
+      } else {
+        BOOST_CHECK_EQUAL(view.value<uint32_t>(index), index);
+      }
+    }
+  }
+};
+
+}  // namespace
+
+BOOST_FIXTURE_TEST_SUITE(message_view, ViewFixture)
+
+BOOST_AUTO_TEST_CASE(reads_fields_out_of_order) {
+  MessageView view(message(), &buffer[0]);
+  const size_t kOrder[] = {
+    kFieldCount - 2, 5, kFieldCount - 2, 3, kFieldCount - 1, 0, 20, 19, 20};
+  for (size_t i = 0; i < sizeof(kOrder) / sizeof(kOrder[0]); i++) {
+    checkField(view, kOrder[i]);
+  }
+  BOOST_CHECK_EQUAL(view.size(), buffer.size());
+  BOOST_CHECK_EQUAL(view.offset("f7"), view.offset(7));
+}
+
+BOOST_AUTO_TEST_CASE(reads_inline_offsets) {
+  MessageView view(message(), &buffer[0]);
+  checkField(view, MessageView::kInlineOffsets - 2);
+  checkField(view, 1);
+  checkField(view, MessageView::kInlineOffsets - 1);
+}
+
+BOOST_AUTO_TEST_CASE(copies_offsets) {
+  MessageView inline_view(message(), &buffer[0]);
+  checkField(inline_view, 9);
+  MessageView heap_view(message(), &buffer[0]);
+  checkField(heap_view, kFieldCount - 3);
+
+  // Copies keep the offsets that are already known and extend them
+  // independently of the original.
+  MessageView inline_copy(inline_view);
+  checkField(inline_copy, kFieldCount - 1);
+  checkField(inline_copy, 4);
+  checkField(inline_view, 11);
+  MessageView heap_copy(heap_view);
+  checkField(heap_copy, kFieldCount - 3);
+  checkField(heap_copy, kFieldCount - 1);
+  BOOST_CHECK_EQUAL(heap_copy.size(), buffer.size());
+  checkField(heap_view, kFieldCount - 1);
+
+  MessageView assigned(message(), &buffer[0]);
+  assigned = heap_view;
+  checkField(assigned, 2);
+  checkField(assigned, kFieldCount - 2);
+  assigned = inline_view;
+  checkField(assigned, kFieldCount - 1);
+}
+
+BOOST_AUTO_TEST_CASE(resets_to_other_buffers) {
+  std::vector<uint8_t> other(buffer);
+  // Make the first string one byte shorter, which moves every later field.
+  other.erase(other.begin() + 8);
+  other[4] -= 1;
+  MessageView view(message(), &buffer[0]);
+  checkField(view, kFieldCount - 1);
+  view.reset(message(), &other[0]);
+  BOOST_CHECK_EQUAL(view.size(), other.size());
+  BOOST_CHECK_EQUAL(
+      view.offset(kFieldCount - 1),
+      message().fieldPath("f33").offset(&other[0]));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
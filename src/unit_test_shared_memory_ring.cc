@@ -0,0 +1,212 @@
+/**
+ * Copyright (c) 2013, Lorenz Moesenlechner <moesenle@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The names of the contributors may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+#include <generic_message/json_encoder.h>
+#include <generic_message/message_pool.h>
+#include <generic_message/shared_memory_ring.h>
+
+using namespace generic_message;
+
+namespace {
+
+const size_t kSlotCount = 4;
+const size_t kSlotSize = 64;
+
+struct RingFixture {
+  MessagePool pool;
+
+  RingFixture() {
+    pool.add("test_msgs", "Sample", "uint32 value\nstring label\n");
+    pool.add("test_msgs", "Other", "uint64 value\n");
+  }
+
+  const CompiledMessage &message() const {
+    return pool.get("test_msgs", "Sample");
+  }
+
+  std::vector<uint8_t> sample(uint32_t value) const {
+    std::ostringstream json;
+    json << "{\"value\": " << value << ", \"label\": \"sample " << value
+         << "\"}";
+    std::vector<uint8_t> buffer;
+    JsonEncoder().encode(message(), json.str(), &buffer);
+    return buffer;
+  }
+
+  void write(RingWriter *writer, uint32_t begin, uint32_t end) const {
+    for (uint32_t i = begin; i < end; i++) {
+      std::vector<uint8_t> buffer = sample(i);
+      writer->write(&buffer[0], buffer.size());
+    }
+  }
+};
+
+std::string uniqueName(const std::string &suffix) {
+  std::ostringstream name;
+  name << "/generic_message_test_" << getpid() << "_" << suffix;
+  return name.str();
+}
+
+}  // namespace
+
+BOOST_FIXTURE_TEST_SUITE(shared_memory_ring, RingFixture)
+
+BOOST_AUTO_TEST_CASE(round_trip) {
+  RingWriter writer(std::string(), message(), kSlotCount, kSlotSize);
+  RingReader reader(writer.memory().fd(), message());
+  RingMessage read;
+  BOOST_CHECK(!reader.read(&read));
+  write(&writer, 0, 3);
+  for (uint32_t i = 0; i < 3; i++) {
+    BOOST_REQUIRE(reader.read(&read));
+    std::vector<uint8_t> expected = sample(i);
+    BOOST_CHECK_EQUAL(read.sequence, i);
+    BOOST_REQUIRE_EQUAL(read.size, expected.size());
+    BOOST_CHECK(memcmp(read.data, &expected[0], read.size) == 0);
+    BOOST_CHECK(reader.isCurrent(read));
+  }
+  BOOST_CHECK(!reader.read(&read));
+  BOOST_CHECK_EQUAL(reader.dropped(), 0u);
+  BOOST_CHECK_EQUAL(writer.sequence(), 3u);
+}
+
+BOOST_AUTO_TEST_CASE(copies_messages_out) {
+  RingWriter writer(std::string(), message(), kSlotCount, kSlotSize);
+  RingReader reader(writer.memory().fd(), message());
+  write(&writer, 0, 2);
+  std::vector<uint8_t> data;
+  uint64_t sequence = 0;
+  BOOST_REQUIRE(reader.read(&data, &sequence));
+  BOOST_CHECK(data == sample(0));
+  BOOST_CHECK_EQUAL(sequence, 0u);
+  BOOST_REQUIRE(reader.read(&data, &sequence));
+  BOOST_CHECK(data == sample(1));
+  BOOST_CHECK_EQUAL(sequence, 1u);
+  BOOST_CHECK(!reader.read(&data, &sequence));
+}
+
+BOOST_AUTO_TEST_CASE(rejects_other_message_types) {
+  RingWriter writer(std::string(), message(), kSlotCount, kSlotSize);
+  BOOST_CHECK_THROW(
+      RingReader(writer.memory().fd(), pool.get("test_msgs", "Other")),
+      RingError);
+}
+
+BOOST_AUTO_TEST_CASE(counts_overrun_messages) {
+  RingWriter writer(std::string(), message(), kSlotCount, kSlotSize);
+  RingReader reader(writer.memory().fd(), message());
+  write(&writer, 0, 10);
+  RingMessage read;
+  for (uint32_t i = 10 - kSlotCount; i < 10; i++) {
+    BOOST_REQUIRE(reader.read(&read));
+    BOOST_CHECK_EQUAL(read.sequence, i);
+    BOOST_CHECK(memcmp(read.data, &sample(i)[0], read.size) == 0);
+  }
+  BOOST_CHECK(!reader.read(&read));
+  BOOST_CHECK_EQUAL(reader.dropped(), 10 - kSlotCount);
+}
+
+BOOST_AUTO_TEST_CASE(detects_reused_slots) {
+  RingWriter writer(std::string(), message(), kSlotCount, kSlotSize);
+  RingReader reader(writer.memory().fd(), message());
+  write(&writer, 0, 1);
+  RingMessage read;
+  BOOST_REQUIRE(reader.read(&read));
+  write(&writer, 1, kSlotCount);
+  BOOST_CHECK(reader.isCurrent(read));
+  // The next message wraps around into the slot of the first one.
+  writer.reserve(kSlotSize);
+  BOOST_CHECK(!reader.isCurrent(read));
+  writer.commit();
+  BOOST_CHECK(!reader.isCurrent(read));
+}
+
+BOOST_AUTO_TEST_CASE(rejects_invalid_sizes) {
+  BOOST_CHECK_THROW(
+      RingWriter(std::string(), message(), 0, kSlotSize), RingError);
+  BOOST_CHECK_THROW(
+      RingWriter(std::string(), message(), kSlotCount, 0), RingError);
+  BOOST_CHECK_THROW(
+      RingWriter(
+          std::string(), message(), std::numeric_limits<size_t>::max() / 64,
+          kSlotSize),
+      RingError);
+  BOOST_CHECK_THROW(
+      RingWriter(
+          std::string(), message(), kSlotCount,
+          std::numeric_limits<size_t>::max() - 8),
+      RingError);
+  RingWriter writer(std::string(), message(), kSlotCount, kSlotSize);
+  BOOST_CHECK_THROW(writer.reserve(kSlotSize + 1), RingError);
+}
+
+BOOST_AUTO_TEST_CASE(does_not_replace_existing_rings) {
+  std::string name = uniqueName("exclusive");
+  SharedMemory::remove(name);
+  {
+    RingWriter writer(name, message(), kSlotCount, kSlotSize);
+    BOOST_CHECK_THROW(
+        RingWriter(name, message(), kSlotCount, kSlotSize), RingError);
+    RingReader reader(name, message());
+    write(&writer, 0, 1);
+    RingMessage read;
+    BOOST_CHECK(reader.read(&read));
+  }
+  // The writer unlinks the ring when it is destroyed.
+  BOOST_CHECK(!SharedMemory::remove(name));
+}
+
+BOOST_AUTO_TEST_CASE(removes_stale_rings) {
+  std::string name = uniqueName("stale");
+  SharedMemory::remove(name);
+  // Left behind like by a writer that crashed.
+  int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0600);
+  BOOST_REQUIRE(fd >= 0);
+  close(fd);
+  BOOST_CHECK_THROW(
+      RingWriter(name, message(), kSlotCount, kSlotSize), RingError);
+  BOOST_CHECK(SharedMemory::remove(name));
+  RingWriter writer(name, message(), kSlotCount, kSlotSize);
+  RingReader reader(name, message());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
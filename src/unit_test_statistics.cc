@@ -0,0 +1,113 @@
+/**
+ * Copyright (c) 2013, Lorenz Moesenlechner <moesenle@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The names of the contributors may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+#include <generic_message/compiled_message.h>
+#include <generic_message/json_encoder.h>
+#include <generic_message/message_pool.h>
+#include <generic_message/statistics.h>
+
+using namespace generic_message;
+
+BOOST_AUTO_TEST_SUITE(statistics)
+
+BOOST_AUTO_TEST_CASE(snapshots_are_empty_when_disabled) {
+  if (statisticsEnabled()) {
+    return;
+  }
+  MessagePool pool;
+  pool.add("test_msgs", "Value", "string label\nuint32 value\n");
+  std::vector<uint8_t> buffer;
+  JsonEncoder().encode(
+      pool.get("test_msgs", "Value"), "{\"label\": \"a\", \"value\": 1}",
+      &buffer);
+  pool.get("test_msgs", "Value").offset("value", &buffer[0]);
+  Statistics statistics = statisticsSnapshot();
+  BOOST_CHECK_EQUAL(statistics.pool_get_calls, 0u);
+  BOOST_CHECK_EQUAL(statistics.bytes_walked, 0u);
+  BOOST_CHECK(statistics.dynamic_offset_evaluations_by_field.empty());
+}
+
+// Offsets behind a string of 3 bytes and an array of 2 uint32 walk both
+// dynamic fields, including their length prefixes.
+BOOST_AUTO_TEST_CASE(counts_dynamic_offsets) {
+  if (!statisticsEnabled()) {
+    return;
+  }
+  MessagePool pool;
+  pool.add("test_msgs", "Walked", "string label\nuint32[] values\nuint32 last\n");
+  const CompiledMessage &message = pool.get("test_msgs", "Walked");
+  std::vector<uint8_t> buffer;
+  JsonEncoder().encode(
+      message, "{\"label\": \"abc\", \"values\": [1, 2], \"last\": 3}", &buffer);
+
+  resetStatistics();
+  BOOST_CHECK_EQUAL(message.offset("last", &buffer[0]), 19u);
+  Statistics statistics = statisticsSnapshot();
+  BOOST_CHECK_EQUAL(statistics.bytes_walked, 19u);
+  BOOST_CHECK_EQUAL(statistics.dynamic_offset_evaluations, 2u);
+  BOOST_CHECK_EQUAL(
+      statistics.dynamic_offset_evaluations_by_field["test_msgs/Walked.label"],
+      1u);
+  BOOST_CHECK_EQUAL(
+      statistics.dynamic_offset_evaluations_by_field["test_msgs/Walked.values"],
+      1u);
+
+  message.offset("values", &buffer[0]);
+  statistics = statisticsSnapshot();
+  BOOST_CHECK_EQUAL(statistics.bytes_walked, 26u);
+  BOOST_CHECK_EQUAL(
+      statistics.dynamic_offset_evaluations_by_field["test_msgs/Walked.label"],
+      2u);
+  BOOST_CHECK_EQUAL(
+      statistics.dynamic_offset_evaluations_by_field["test_msgs/Walked.values"],
+      1u);
+
+  // Resetting records a baseline, later snapshots count from there.
+  resetStatistics();
+  statistics = statisticsSnapshot();
+  BOOST_CHECK_EQUAL(statistics.bytes_walked, 0u);
+  BOOST_CHECK_EQUAL(statistics.dynamic_offset_evaluations, 0u);
+  BOOST_CHECK_EQUAL(
+      statistics.dynamic_offset_evaluations_by_field["test_msgs/Walked.label"],
+      0u);
+  message.offset("last", &buffer[0]);
+  statistics = statisticsSnapshot();
+  BOOST_CHECK_EQUAL(statistics.bytes_walked, 19u);
+  BOOST_CHECK_EQUAL(
+      statistics.dynamic_offset_evaluations_by_field["test_msgs/Walked.values"],
+      1u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
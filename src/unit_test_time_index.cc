@@ -0,0 +1,252 @@
+/**
+ * Copyright (c) 2013, Lorenz Moesenlechner <moesenle@gmail.com>
+ * All rights reserved.
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * The names of the contributors may not be used to endorse or promote
+ *       products derived from this software without specific prior written
+ *       permission.
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <limits>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <boost/foreach.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <generic_message/field_mutator.h>
+#include <generic_message/json_encoder.h>
+#include <generic_message/message_pool.h>
+#include <generic_message/time_index.h>
+
+using namespace generic_message;
+
+namespace {
+
+// More than two blocks, so that queries cross block boundaries.
+const size_t kMessageCount = 300;
+const uint64_t kEnd = std::numeric_limits<uint64_t>::max();
+
+struct StampAndOffset {
+  uint64_t stamp;
+  uint64_t offset;
+
+  StampAndOffset(uint64_t stamp, uint64_t offset)
+      : stamp(stamp), offset(offset) {}
+
+  bool operator<(const StampAndOffset &other) const {
+    return stamp < other.stamp ||
+        (stamp == other.stamp && offset < other.offset);
+  }
+  bool operator!=(const StampAndOffset &other) const {
+    return stamp != other.stamp || offset != other.offset;
+  }
+};
+
+std::ostream &operator<<(std::ostream &stream, const StampAndOffset &entry) {
+  return stream << entry.stamp << "@" << entry.offset;
+}
+
+// Stamps are out of order and every stamp is used by three messages. The
+// messages with the same stamp end up at sorted positions 126 to 128 and
+// 255 to 257, on both sides of a block boundary.
+uint64_t stampOf(size_t i) {
+  size_t key = i * 7919 % kMessageCount / 3;
+  return TimeIndex::toNanoseconds(1000 + key / 10, key % 10 * 100000000);
+}
+
+// Writes a stream of stamped messages and its index to temporary files
+// and keeps the expected entries sorted by stamp and offset.
+struct TimeIndexFixture {
+  MessagePool pool;
+  std::vector<uint8_t> stream;
+  std::vector<StampAndOffset> expected;
+  std::vector<std::string> files;
+  std::string stream_file;
+  std::string index_file;
+
+  TimeIndexFixture() {
+    pool.add("std_msgs", "Header",
+             "uint32 seq\n"
+             "time stamp\n"
+             "string frame_id\n");
+    pool.add("test_msgs", "Stamped",
+             "std_msgs/Header header\n"
+             "string payload\n");
+    pool.add("test_msgs", "Other", "std_msgs/Header header\n");
+    FieldMutator seq(message(), "header.seq");
+    FieldMutator stamp(message(), "header.stamp");
+    for (size_t i = 0; i < kMessageCount; i++) {
+      // Payloads of different lengths, so offsets are not a multiple of
+      // the message size.
+      std::vector<uint8_t> buffer;
+      JsonEncoder().encode(
+          message(),
+          "{\"header\": {\"frame_id\": \"map\"},"
+          " \"payload\": \"" + std::string(i % 7, 'p') + "\"}",
+          &buffer);
+      seq.set<uint32_t>(&buffer[0], i);
+      uint64_t nanoseconds = stampOf(i);
+      stamp.setTime(&buffer[0], nanoseconds / 1000000000,
+                    nanoseconds % 1000000000);
+      expected.push_back(StampAndOffset(nanoseconds, stream.size()));
+      uint32_t length = buffer.size();
+      const uint8_t *prefix = reinterpret_cast<const uint8_t *>(&length);
+      stream.insert(stream.end(), prefix, prefix + 4);
+      stream.insert(stream.end(), buffer.begin(), buffer.end());
+    }
+    std::sort(expected.begin(), expected.end());
+    stream_file = writeFile(stream);
+    index_file = writeFile(std::vector<uint8_t>());
+    TimeIndexBuilder builder(message(), "header.stamp");
+    builder.addStreamFile(stream_file);
+    BOOST_REQUIRE_EQUAL(builder.size(), kMessageCount);
+    builder.write(index_file);
+  }
+
+  ~TimeIndexFixture() {
+    BOOST_FOREACH(const std::string &file, files) {
+      unlink(file.c_str());
+    }
+  }
+
+  const CompiledMessage &message() const {
+    return pool.get("test_msgs", "Stamped");
+  }
+
+  std::string writeFile(const std::vector<uint8_t> &data) {
+    char name[] = "/tmp/unit_test_time_index.XXXXXX";
+    int fd = mkstemp(name);
+    BOOST_REQUIRE(fd >= 0);
+    files.push_back(name);
+    BOOST_REQUIRE_EQUAL(
+        write(fd, data.empty() ? 0 : &data[0], data.size()),
+        static_cast<ssize_t>(data.size()));
+    close(fd);
+    return name;
+  }
+
+  void checkQuery(const TimeIndex &index, uint64_t begin, uint64_t end) {
+    BOOST_TEST_CONTEXT("query [" << begin << ", " << end << ")") {
+      std::vector<TimeIndex::Entry> entries;
+      index.query(begin, end, &entries);
+      std::vector<StampAndOffset> found;
+      BOOST_FOREACH(const TimeIndex::Entry &entry, entries) {
+        found.push_back(StampAndOffset(entry.stamp, entry.offset));
+      }
+      std::vector<StampAndOffset> wanted;
+      BOOST_FOREACH(const StampAndOffset &entry, expected) {
+        if (entry.stamp >= begin && entry.stamp < end) {
+          wanted.push_back(entry);
+        }
+      }
+      BOOST_CHECK_EQUAL_COLLECTIONS(
+          found.begin(), found.end(), wanted.begin(), wanted.end());
+    }
+  }
+};
+
+}  // namespace
+
+BOOST_FIXTURE_TEST_SUITE(time_index, TimeIndexFixture)
+
+BOOST_AUTO_TEST_CASE(queries_whole_stream) {
+  TimeIndex index(message(), stream_file, index_file);
+  BOOST_CHECK_EQUAL(index.size(), kMessageCount);
+  checkQuery(index, 0, kEnd);
+  checkQuery(index, expected.front().stamp, expected.back().stamp + 1);
+}
+
+BOOST_AUTO_TEST_CASE(queries_boundaries) {
+  TimeIndex index(message(), stream_file, index_file);
+  const size_t positions[] = {0, 1, 2, 3, 126, 127, 128, 129, 255, 256, 257,
+                              kMessageCount - 1};
+  BOOST_REQUIRE_EQUAL(expected[126].stamp, expected[128].stamp);
+  BOOST_REQUIRE_EQUAL(expected[255].stamp, expected[257].stamp);
+  BOOST_FOREACH(size_t position, positions) {
+    uint64_t stamp = expected[position].stamp;
+    checkQuery(index, stamp, stamp + 1);
+    checkQuery(index, stamp, kEnd);
+    checkQuery(index, 0, stamp);
+    checkQuery(index, stamp + 1, kEnd);
+    checkQuery(index, stamp - 1, stamp + 100000000);
+  }
+  checkQuery(index, expected[127].stamp, expected[257].stamp);
+}
+
+BOOST_AUTO_TEST_CASE(queries_empty_ranges) {
+  TimeIndex index(message(), stream_file, index_file);
+  std::vector<TimeIndex::Entry> entries;
+  uint64_t stamp = expected[128].stamp;
+  index.query(stamp, stamp, &entries);
+  BOOST_CHECK(entries.empty());
+  index.query(stamp + 1, stamp, &entries);
+  BOOST_CHECK(entries.empty());
+  index.query(0, expected.front().stamp, &entries);
+  BOOST_CHECK(entries.empty());
+  index.query(expected.back().stamp + 1, kEnd, &entries);
+  BOOST_CHECK(entries.empty());
+  // Between two stamps that are in use.
+  index.query(stamp + 1, stamp + 100000000, &entries);
+  BOOST_CHECK(entries.empty());
+}
+
+BOOST_AUTO_TEST_CASE(maps_messages) {
+  TimeIndex index(message(), stream_file, index_file);
+  std::vector<TimeIndex::Entry> entries;
+  index.query(0, kEnd, &entries);
+  BOOST_REQUIRE_EQUAL(entries.size(), kMessageCount);
+  const FieldPath &seq = message().fieldPath("header.seq");
+  BOOST_FOREACH(const TimeIndex::Entry &entry, entries) {
+    size_t size = 0;
+    const uint8_t *data =
+        static_cast<const uint8_t *>(index.message(entry, &size));
+    BOOST_REQUIRE_EQUAL(size, message().size(data));
+    BOOST_CHECK_EQUAL(memcmp(data, &stream[entry.offset + 4], size), 0);
+    uint32_t i = 0;
+    memcpy(&i, data + seq.offset(data), sizeof(i));
+    BOOST_CHECK_EQUAL(entry.stamp, stampOf(i));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(rejects_mismatched_files) {
+  BOOST_CHECK_THROW(
+      TimeIndex(pool.get("test_msgs", "Other"), stream_file, index_file),
+      TimeIndexError);
+  std::vector<uint8_t> truncated(stream.begin(), stream.end() - 1);
+  BOOST_CHECK_THROW(
+      TimeIndex(message(), writeFile(truncated), index_file), TimeIndexError);
+  BOOST_CHECK_THROW(
+      TimeIndex(message(), stream_file, stream_file), TimeIndexError);
+  BOOST_CHECK_THROW(
+      TimeIndexBuilder(message(), "header.seq"), TimeIndexError);
+}
+
+BOOST_AUTO_TEST_SUITE_END()